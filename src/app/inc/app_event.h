@@ -0,0 +1,36 @@
+#ifndef APP_EVENT_H_
+#define APP_EVENT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+
+// Events handled by the application event loop. Producers keep the payload
+// in their own mailbox or queue and only post the event type, so repeated
+// events of the same type merge into a single wakeup.
+#define APP_EVENT_RTC_TICK       BIT(0)   // New time in the RTC mailbox
+#define APP_EVENT_DISPLAY_MSG    BIT(1)   // New message in the display queue
+#define APP_EVENT_BUTTON         BIT(2)   // Button pressed
+#define APP_EVENT_DISPLAY        BIT(3)   // Display work pending (e.g. marquee step)
+#define APP_EVENT_DFU            BIT(4)   // New firmware upload progress
+#define APP_EVENT_FACE           BIT(5)   // Watch face selection requested
+
+#define APP_EVENT_ALL            (APP_EVENT_RTC_TICK | APP_EVENT_DISPLAY_MSG | \
+                                  APP_EVENT_BUTTON | APP_EVENT_DISPLAY | APP_EVENT_DFU | \
+                                  APP_EVENT_FACE)
+
+void app_event_post(uint32_t events);
+uint32_t app_event_wait(k_timeout_t timeout);
+uint32_t app_event_wakeups(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* APP_EVENT_H_ */
@@ -0,0 +1,44 @@
+#ifndef APP_DFU_PROGRESS_H_
+#define APP_DFU_PROGRESS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum dfu_progress_state
+{
+   DFU_PROGRESS_IDLE = 0,
+   DFU_PROGRESS_UPLOADING,
+   DFU_PROGRESS_DONE,
+   DFU_PROGRESS_FAILED,
+} dfu_progress_state_t;
+
+// Image upload progress. Times are in ms from any monotonic clock.
+typedef struct dfu_progress
+{
+   uint8_t state;
+   uint8_t percent;
+   uint32_t offset;
+   uint32_t size;
+   uint32_t bytes_per_s;
+   uint32_t elapsed_ms;
+   uint32_t start_ms;
+   uint32_t report_ms;
+} dfu_progress_t;
+
+void dfu_progress_start(dfu_progress_t *progress, uint32_t size, uint32_t now_ms);
+bool dfu_progress_update(dfu_progress_t *progress, uint32_t offset, uint32_t now_ms,
+                         uint32_t report_interval_ms);
+void dfu_progress_finish(dfu_progress_t *progress, bool success, uint32_t now_ms);
+int dfu_progress_format(const dfu_progress_t *progress, char *buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* APP_DFU_PROGRESS_H_ */
@@ -0,0 +1,21 @@
+#ifndef APP_DFU_SMP_H_
+#define APP_DFU_SMP_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "dfu_progress.h"
+
+int dfu_smp_init(void);
+bool dfu_smp_get_progress(dfu_progress_t *progress, uint32_t *version);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* APP_DFU_SMP_H_ */
@@ -6,14 +6,21 @@ extern "C" {
 #endif
 
 #include <stdio.h>
+#include <stdint.h>
 
 #define DISPLAY_MSG_BUFFER_SIZE     32
+// Messages on the message list face
+#define DISPLAY_MSG_LIST_LINES      4
 
 void display_ssd1306_init(void);
 void display_ssd1306_run_handler(void);
 const char* display_ssd1306_get_msg_string(void);
 void display_ssd1306_set_msg_string(const char* msg, uint16_t size);
 void display_ssd1306_update_date_time(const char *date_time_string);
+void display_ssd1306_history_browse(void);
+void display_ssd1306_set_status(const char *status);
+void display_ssd1306_set_field(uint8_t field, const char *text);
+void display_ssd1306_select_face(uint8_t face);
 
 #ifdef __cplusplus
 }
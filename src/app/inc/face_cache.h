@@ -0,0 +1,47 @@
+#ifndef APP_FACE_CACHE_H_
+#define APP_FACE_CACHE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Full SSD1306 frame in the controller layout: 8 pages of 8 rows, one byte
+// per column and page, bit n of a byte is row n of the page.
+#define FACE_CACHE_WIDTH         128
+#define FACE_CACHE_HEIGHT        64
+#define FACE_CACHE_SIZE          (FACE_CACHE_WIDTH * FACE_CACHE_HEIGHT / 8)
+#define FACE_CACHE_MAX_ITEMS     8
+
+typedef struct face_cache_area
+{
+   int16_t x1;
+   int16_t y1;
+   int16_t x2;
+   int16_t y2;
+} face_cache_area_t;
+
+// Off-screen frame of a watch face, with the version of the field drawn by
+// each layout item and where it was drawn
+struct face_cache
+{
+   uint8_t frame[FACE_CACHE_SIZE];
+   uint32_t versions[FACE_CACHE_MAX_ITEMS];
+   face_cache_area_t areas[FACE_CACHE_MAX_ITEMS];
+   bool valid;
+};
+
+void face_cache_blit(struct face_cache *cache, const uint8_t *buf, int16_t x, int16_t y,
+                     uint16_t width, uint16_t height);
+void face_cache_mark(struct face_cache *cache, uint8_t item, uint32_t version,
+                     const face_cache_area_t *area);
+bool face_cache_is_stale(const struct face_cache *cache, uint8_t item, uint32_t version);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* APP_FACE_CACHE_H_ */
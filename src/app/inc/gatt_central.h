@@ -7,19 +7,26 @@ extern "C" {
 
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 
 // OLED Display SSD1306
 #include "display_ssd1306.h"
+#include "mpsc_queue.h"
 
 typedef struct display_msg
 {
    char msg_buffer[DISPLAY_MSG_BUFFER_SIZE];
 } display_msg_t;
 
-extern struct k_msgq display_msg_queue;
+extern struct mpsc_queue display_msg_queue;
 
 int gatt_central_bt_start_advertising(void);
 void gatt_server_battery_level_notify(void);
+void gatt_server_display_msg_notify(void);
+void gatt_server_time_notify(void);
+void gatt_server_get_notify_stats(uint32_t *sent, uint32_t *suppressed);
+uint8_t gatt_server_connection_count(void);
+uint8_t gatt_server_battery_level(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,46 @@
+#ifndef APP_LATEST_MAILBOX_H_
+#define APP_LATEST_MAILBOX_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <zephyr/sys/atomic.h>
+
+// Latest value mailbox protected by a sequence lock.
+// One writer, any number of readers. The writer never blocks and readers
+// always get the newest complete value, retrying if a write overlapped.
+// A reader spins while a write is in progress, so a reader must never be
+// able to preempt the writer in the middle of a write: on a single core a
+// reader of higher priority than a preempted writer would spin forever.
+// Writes run with the scheduler locked to rule this out, which means the
+// writer must be a thread and readers must not be ISRs. Readers yield
+// between retries so a writer of the same priority can finish.
+struct latest_mailbox
+{
+   atomic_t seq;
+   void *data;
+   size_t size;
+};
+
+#define LATEST_MAILBOX_DEFINE(name, type)          \
+   static type _latest_mailbox_data_##name;        \
+   struct latest_mailbox name = {                  \
+      .seq = ATOMIC_INIT(0),                       \
+      .data = &_latest_mailbox_data_##name,        \
+      .size = sizeof(type),                        \
+   }
+
+void latest_mailbox_write(struct latest_mailbox *mb, const void *value);
+bool latest_mailbox_read(struct latest_mailbox *mb, void *value, uint32_t *version);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* APP_LATEST_MAILBOX_H_ */
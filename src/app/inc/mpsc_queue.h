@@ -0,0 +1,50 @@
+#ifndef APP_MPSC_QUEUE_H_
+#define APP_MPSC_QUEUE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+
+// Bounded lock-free queue, many producers and a single consumer.
+// Each slot has a sequence number telling whose turn it is, so producers
+// only contend on the head index and a full queue is reported to the
+// producer instead of dropping queued items.
+struct mpsc_queue
+{
+   uint8_t *buffer;
+   atomic_t *turn;
+   size_t item_size;
+   uint32_t mask;
+   atomic_t head;
+   uint32_t tail;
+   atomic_t dropped;
+};
+
+// capacity must be a power of two
+#define MPSC_QUEUE_DEFINE(name, q_item_size, q_capacity)                               \
+   BUILD_ASSERT(IS_POWER_OF_TWO(q_capacity), "Capacity must be a power of two");       \
+   static uint8_t _mpsc_queue_buffer_##name[(q_item_size) * (q_capacity)] __aligned(4); \
+   static atomic_t _mpsc_queue_turn_##name[q_capacity];                                 \
+   struct mpsc_queue name = {                                                           \
+      .buffer = _mpsc_queue_buffer_##name,                                              \
+      .turn = _mpsc_queue_turn_##name,                                                  \
+      .item_size = (q_item_size),                                                       \
+      .mask = (q_capacity) - 1U,                                                        \
+   }
+
+int mpsc_queue_put(struct mpsc_queue *q, const void *item);
+int mpsc_queue_get(struct mpsc_queue *q, void *item);
+uint32_t mpsc_queue_dropped(struct mpsc_queue *q);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* APP_MPSC_QUEUE_H_ */
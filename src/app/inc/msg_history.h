@@ -0,0 +1,41 @@
+#ifndef APP_MSG_HISTORY_H_
+#define APP_MSG_HISTORY_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// OLED Display SSD1306
+#include "display_ssd1306.h"
+
+// Size of the page header: oldest sequence (4), newest sequence (4), entries count (1)
+#define MSG_HISTORY_PAGE_HEADER_SIZE   9
+// Size of an entry header inside a page: sequence (4), timestamp (4), length (1)
+#define MSG_HISTORY_ENTRY_HEADER_SIZE  9
+// Smallest page that holds one message of any length
+#define MSG_HISTORY_PAGE_MIN_SIZE      (MSG_HISTORY_PAGE_HEADER_SIZE + MSG_HISTORY_ENTRY_HEADER_SIZE + \
+                                        DISPLAY_MSG_BUFFER_SIZE - 1)
+
+typedef struct msg_history_entry
+{
+   uint32_t seq;
+   uint32_t timestamp;
+   uint8_t len;
+   char msg_buffer[DISPLAY_MSG_BUFFER_SIZE];
+} msg_history_entry_t;
+
+uint32_t msg_history_add(const char *msg, uint16_t size, uint32_t timestamp);
+int msg_history_get(uint32_t seq, msg_history_entry_t *entry);
+uint16_t msg_history_range(uint32_t *oldest_seq, uint32_t *newest_seq);
+size_t msg_history_encode_page(uint32_t start_seq, uint8_t *buf, size_t size);
+void msg_history_clear(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* APP_MSG_HISTORY_H_ */
@@ -0,0 +1,56 @@
+#ifndef APP_NOTIFY_COALESCE_H_
+#define APP_NOTIFY_COALESCE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+
+#define NOTIFY_COALESCE_VALUE_MAX   32
+
+// Fills buf with the current characteristic value and returns its size
+typedef uint16_t (*notify_coalesce_value_cb_t)(uint8_t *buf, uint16_t size);
+
+struct notify_coalesce;
+
+struct notify_coalesce_conn
+{
+   struct notify_coalesce *owner;
+   struct k_work_delayable work;
+   struct bt_gatt_indicate_params ind_params;
+   atomic_t pending;
+   atomic_t indicating;
+   // Written by the work handler, read by the threads that mark changes
+   struct k_spinlock lock;
+   int64_t last_sent;
+   uint8_t index;
+   uint8_t value[NOTIFY_COALESCE_VALUE_MAX];
+};
+
+struct notify_coalesce
+{
+   const struct bt_gatt_attr *attr;
+   notify_coalesce_value_cb_t get_value;
+   atomic_t sent;
+   atomic_t suppressed;
+   struct notify_coalesce_conn conns[CONFIG_BT_MAX_CONN];
+};
+
+void notify_coalesce_init(struct notify_coalesce *nc, const struct bt_gatt_attr *attr,
+                          notify_coalesce_value_cb_t get_value);
+void notify_coalesce_changed(struct notify_coalesce *nc);
+void notify_coalesce_conn_reset(struct notify_coalesce *nc, struct bt_conn *conn);
+uint32_t notify_coalesce_sent(const struct notify_coalesce *nc);
+uint32_t notify_coalesce_suppressed(const struct notify_coalesce *nc);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* APP_NOTIFY_COALESCE_H_ */
@@ -6,11 +6,16 @@ extern "C" {
 #endif
 
 #include <stdio.h>
+#include <stdint.h>
 
 #define RTC_MSG_BUFFER_SIZE     64
 
-void rtc_ds3231_init(void);
+// Called every second with the time formatted as YYYY-MM-DD HH:MM:SS DOW DOY
+typedef void (*rtc_ds3231_tick_cb_t)(const char *date_time);
+
+void rtc_ds3231_init(rtc_ds3231_tick_cb_t tick_cb);
 const char* rtc_ds3231_get_last_time(void);
+uint32_t rtc_ds3231_get_last_timestamp(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,35 @@
+#ifndef APP_SSD1306_MARQUEE_H_
+#define APP_SSD1306_MARQUEE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <lvgl.h>
+
+// The marquee uses the two bottom pages of the screen (rows 48 to 63)
+#define MARQUEE_FIRST_PAGE       6
+#define MARQUEE_PAGES            2
+#define MARQUEE_Y                (MARQUEE_FIRST_PAGE * 8)
+#define MARQUEE_HEIGHT           (MARQUEE_PAGES * 8)
+#define MARQUEE_WIDTH            128
+#define MARQUEE_STRIP_MAX_COLS   512
+
+int ssd1306_marquee_init(const struct device *display_dev);
+int ssd1306_marquee_start(const char *text, const lv_font_t *font, bool ink_bit);
+void ssd1306_marquee_stop(void);
+void ssd1306_marquee_pause(void);
+void ssd1306_marquee_resume(void);
+bool ssd1306_marquee_is_active(void);
+void ssd1306_marquee_process(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* APP_SSD1306_MARQUEE_H_ */
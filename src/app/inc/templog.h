@@ -0,0 +1,21 @@
+#ifndef APP_TEMPLOG_H_
+#define APP_TEMPLOG_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "templog_codec.h"
+
+int templog_init(void);
+void templog_get_range(uint32_t *start_offset, uint32_t *end_offset);
+int templog_read(uint32_t offset, uint8_t *buf, uint16_t len, uint32_t *read_offset);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* APP_TEMPLOG_H_ */
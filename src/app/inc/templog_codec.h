@@ -0,0 +1,47 @@
+#ifndef APP_TEMPLOG_CODEC_H_
+#define APP_TEMPLOG_CODEC_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Temperature log stream format. Temperatures are in quarter degrees
+// Celsius, the DS3231 resolution.
+//
+// Each block starts with TEMPLOG_CODE_BLOCK followed by the header:
+//   stream offset of the block (u32) | timestamp of the first sample (u32)
+//   sampling period in seconds (u16) | first sample (i16)
+// Each following byte is the difference to the previous sample (i8),
+// except TEMPLOG_CODE_ABS, which is followed by the sample itself (i16).
+// Sample n of a block was taken at timestamp + n * period.
+#define TEMPLOG_CODE_ABS         0x80
+#define TEMPLOG_CODE_BLOCK       0x81
+#define TEMPLOG_BLOCK_HEADER_SIZE 13
+#define TEMPLOG_DELTA_MIN        (-126)
+#define TEMPLOG_DELTA_MAX        127
+
+typedef struct templog_block
+{
+   uint8_t *buf;
+   uint16_t size;
+   uint16_t used;
+   int16_t last;
+} templog_block_t;
+
+typedef void (*templog_sample_cb_t)(uint32_t timestamp, int16_t temp_q, void *user_data);
+
+void templog_block_start(templog_block_t *block, uint8_t *buf, uint16_t size, uint32_t offset,
+                         uint32_t timestamp, uint16_t period_s, int16_t temp_q);
+int templog_block_append(templog_block_t *block, int16_t temp_q);
+uint32_t templog_block_offset(const uint8_t *buf);
+int templog_decode(const uint8_t *buf, size_t len, templog_sample_cb_t cb, void *user_data);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* APP_TEMPLOG_CODEC_H_ */
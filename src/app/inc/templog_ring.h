@@ -0,0 +1,49 @@
+#ifndef APP_TEMPLOG_RING_H_
+#define APP_TEMPLOG_RING_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <zephyr/toolchain.h>
+
+#include "templog_codec.h"
+
+#define TEMPLOG_RING_BLOCKS      CONFIG_APP_TEMPLOG_RAM_BLOCKS
+#define TEMPLOG_RING_BLOCK_SIZE  CONFIG_APP_TEMPLOG_BLOCK_SIZE
+
+// Receives the oldest block when it leaves the ring, with its final length
+typedef void (*templog_spill_cb_t)(const uint8_t *buf, uint16_t len);
+
+// RAM ring of log blocks. The newest block is being filled, the oldest one
+// is spilled when a new block is needed and the ring is full. The length
+// of every block, the open one included, is kept up to date on each sample.
+struct templog_ring
+{
+   uint8_t blocks[TEMPLOG_RING_BLOCKS][TEMPLOG_RING_BLOCK_SIZE] __aligned(4);
+   uint16_t used[TEMPLOG_RING_BLOCKS];
+   uint8_t oldest;
+   uint8_t count;
+   templog_block_t current;
+   bool open;
+   // Stream offset after the newest sample
+   uint32_t end;
+};
+
+void templog_ring_init(struct templog_ring *ring, uint32_t end_offset);
+bool templog_ring_append(struct templog_ring *ring, int16_t temp_q, uint32_t timestamp,
+                         templog_spill_cb_t spill);
+void templog_ring_close(struct templog_ring *ring);
+uint32_t templog_ring_start(const struct templog_ring *ring);
+uint16_t templog_ring_read(const struct templog_ring *ring, uint32_t offset, uint8_t *buf,
+                           uint16_t len);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* APP_TEMPLOG_RING_H_ */
@@ -0,0 +1,50 @@
+#ifndef APP_TIME_SYNC_H_
+#define APP_TIME_SYNC_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Request: phone time (u32 seconds, u32 microseconds)
+#define TIME_SYNC_REQUEST_SIZE   8
+// Result: status (u8), correction ms (i64), residual us (i32), uncertainty us (u16)
+#define TIME_SYNC_RESULT_SIZE    15
+
+enum time_sync_status
+{
+   TIME_SYNC_IDLE = 0,
+   TIME_SYNC_IN_PROGRESS,
+   TIME_SYNC_DONE,
+   TIME_SYNC_FAILED,
+};
+
+typedef struct time_sync_result
+{
+   uint8_t status;
+   // Applied change of the RTC time. 64 bits, since the first sync after a
+   // battery swap can move the RTC by years.
+   int64_t correction_ms;
+   // Difference between the requested time and the synchronization point written
+   int32_t residual_us;
+   // Nominal error bound of the timestamp of the request: the configured
+   // receive jitter plus one syncclock tick. The link delay is an estimate
+   // for a write sent first in its connection event and is not bounded.
+   uint16_t uncertainty_us;
+} time_sync_result_t;
+
+typedef void (*time_sync_done_cb_t)(void);
+
+void time_sync_init(time_sync_done_cb_t done_cb);
+uint32_t time_sync_capture(void);
+int time_sync_request(uint32_t sec, uint32_t usec, uint32_t syncclock, uint32_t link_delay_us);
+void time_sync_get_result(time_sync_result_t *result);
+uint16_t time_sync_encode_result(uint8_t *buf, uint16_t size);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* APP_TIME_SYNC_H_ */
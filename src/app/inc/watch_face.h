@@ -0,0 +1,72 @@
+#ifndef APP_WATCH_FACE_H_
+#define APP_WATCH_FACE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <lvgl.h>
+
+typedef enum watch_face_id
+{
+   WATCH_FACE_CLASSIC = 0,
+   WATCH_FACE_LARGE_CLOCK,
+   WATCH_FACE_MESSAGES,
+   WATCH_FACE_STATUS,
+   WATCH_FACE_DIAGNOSTICS,
+   WATCH_FACE_COUNT,
+} watch_face_id_t;
+
+// Data shown by the faces. A field can appear on several faces.
+typedef enum watch_field
+{
+   WATCH_FIELD_STATIC = 0,   // Fixed text from the layout table
+   WATCH_FIELD_DATE,
+   WATCH_FIELD_TIME,
+   WATCH_FIELD_MESSAGE,
+   WATCH_FIELD_MSG_LIST,
+   WATCH_FIELD_STATUS,
+   WATCH_FIELD_DIAG,
+   WATCH_FIELD_COUNT,
+} watch_field_t;
+
+// One label of a face layout. A NULL font keeps the theme font and a zero
+// width sizes the label to its text.
+typedef struct watch_face_item
+{
+   uint8_t field;
+   const char *text;
+   const lv_font_t *font;
+   lv_align_t align;
+   lv_coord_t x;
+   lv_coord_t y;
+   lv_coord_t width;
+} watch_face_item_t;
+
+typedef struct watch_face
+{
+   const char *name;
+   const watch_face_item_t *items;
+   uint8_t item_count;
+} watch_face_t;
+
+int watch_face_init(const struct device *display_dev, uint8_t face);
+void watch_face_set_text(uint8_t field, const char *text);
+lv_obj_t *watch_face_get_label(uint8_t face, uint8_t field);
+uint8_t watch_face_get_active(void);
+int watch_face_select(uint8_t face);
+void watch_face_request(uint8_t face);
+void watch_face_request_next(void);
+bool watch_face_take_request(uint8_t *face);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* APP_WATCH_FACE_H_ */
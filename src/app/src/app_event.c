@@ -0,0 +1,32 @@
+#include "app_event.h"
+
+K_EVENT_DEFINE(app_events);
+
+static uint32_t wakeups;
+
+// Post events to the event loop. Can be called from ISRs.
+void app_event_post(uint32_t events)
+{
+   k_event_post(&app_events, events);
+}
+
+// Wait for any event and consume all the events posted so far.
+// Returns 0 on timeout. Must only be called by the event loop.
+uint32_t app_event_wait(k_timeout_t timeout)
+{
+   uint32_t events = k_event_wait(&app_events, APP_EVENT_ALL, false, timeout);
+
+   // Events posted after this point wake up the next wait, the payloads
+   // they refer to are consumed by the handlers that run next.
+   k_event_clear(&app_events, events);
+
+   wakeups++;
+
+   return events;
+}
+
+// Number of event loop wakeups since boot
+uint32_t app_event_wakeups(void)
+{
+   return wakeups;
+}
@@ -0,0 +1,87 @@
+#include "dfu_progress.h"
+
+#include <string.h>
+
+static void dfu_progress_measure(dfu_progress_t *progress, uint32_t now_ms)
+{
+   progress->elapsed_ms = now_ms - progress->start_ms;
+
+   if (progress->size > 0U)
+   {
+      progress->percent = (uint8_t)(((uint64_t)progress->offset * 100U) / progress->size);
+   }
+
+   // Average rate since the first chunk, steadier on screen than the rate
+   // of the last chunks, which arrive in bursts
+   if (progress->elapsed_ms > 0U)
+   {
+      progress->bytes_per_s = (uint32_t)(((uint64_t)progress->offset * 1000U) / progress->elapsed_ms);
+   }
+}
+
+// Start tracking the upload of an image of size bytes
+void dfu_progress_start(dfu_progress_t *progress, uint32_t size, uint32_t now_ms)
+{
+   memset(progress, 0, sizeof(*progress));
+
+   progress->state = DFU_PROGRESS_UPLOADING;
+   progress->size = size;
+   progress->start_ms = now_ms;
+   progress->report_ms = now_ms;
+}
+
+// Record that the image was received up to offset.
+// Returns true when the progress should be reported: at most once per
+// report_interval_ms and always for the last chunk.
+bool dfu_progress_update(dfu_progress_t *progress, uint32_t offset, uint32_t now_ms,
+                         uint32_t report_interval_ms)
+{
+   if (progress->state != DFU_PROGRESS_UPLOADING)
+   {
+      return false;
+   }
+
+   progress->offset = offset;
+
+   if (offset < progress->size && now_ms - progress->report_ms < report_interval_ms)
+   {
+      return false;
+   }
+
+   progress->report_ms = now_ms;
+   dfu_progress_measure(progress, now_ms);
+
+   return true;
+}
+
+// End of the upload, complete or aborted
+void dfu_progress_finish(dfu_progress_t *progress, bool success, uint32_t now_ms)
+{
+   if (progress->state == DFU_PROGRESS_UPLOADING)
+   {
+      dfu_progress_measure(progress, now_ms);
+   }
+
+   progress->state = success ? DFU_PROGRESS_DONE : DFU_PROGRESS_FAILED;
+}
+
+// Short status line for the display, e.g. "DFU 45% 21.3kB/s".
+// Returns the snprintf() result.
+int dfu_progress_format(const dfu_progress_t *progress, char *buf, size_t size)
+{
+   uint32_t tenths_kb_s = progress->bytes_per_s / 100U;
+
+   switch (progress->state)
+   {
+   case DFU_PROGRESS_UPLOADING:
+      return snprintf(buf, size, "DFU %u%% %u.%ukB/s", progress->percent,
+                      tenths_kb_s / 10U, tenths_kb_s % 10U);
+   case DFU_PROGRESS_DONE:
+      return snprintf(buf, size, "DFU done %u.%us", progress->elapsed_ms / 1000U,
+                      (progress->elapsed_ms % 1000U) / 100U);
+   case DFU_PROGRESS_FAILED:
+      return snprintf(buf, size, "DFU failed %u%%", progress->percent);
+   default:
+      return snprintf(buf, size, "%s", "");
+   }
+}
@@ -0,0 +1,111 @@
+#include "dfu_smp.h"
+
+#include "app_event.h"
+#include "latest_mailbox.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/dfu/mcuboot.h>
+#include <zephyr/mgmt/mcumgr/mgmt/callbacks.h>
+#include <zephyr/mgmt/mcumgr/grp/img_mgmt/img_mgmt.h>
+#include <zephyr/mgmt/mcumgr/grp/img_mgmt/img_mgmt_callbacks.h>
+
+// Register module log name
+LOG_MODULE_REGISTER(DFU, LOG_LEVEL_DBG);
+
+// Progress of the current upload, only used from the SMP work queue
+static dfu_progress_t progress;
+
+// Latest progress for the event loop, which draws it
+LATEST_MAILBOX_DEFINE(dfu_progress_mailbox, dfu_progress_t);
+
+static enum mgmt_cb_return dfu_smp_event(uint32_t event, enum mgmt_cb_return prev_status,
+                                         int32_t *rc, uint16_t *group, bool *abort_more,
+                                         void *data, size_t data_size);
+
+static struct mgmt_callback dfu_smp_callback = {
+   .callback = dfu_smp_event,
+   .event_id = MGMT_EVT_OP_IMG_MGMT_DFU_CHUNK | MGMT_EVT_OP_IMG_MGMT_DFU_STOPPED |
+               MGMT_EVT_OP_IMG_MGMT_DFU_PENDING,
+};
+
+int dfu_smp_init(void)
+{
+   // An image that was just swapped in runs in test mode, confirm it or
+   // MCUboot reverts to the previous image at the next reset
+   if (!boot_is_img_confirmed())
+   {
+      int err = boot_write_img_confirmed();
+
+      if (err)
+      {
+         LOG_ERR("Image confirmation failed (err %d)", err);
+         return err;
+      }
+
+      LOG_INF("New image confirmed");
+   }
+
+   mgmt_callback_register(&dfu_smp_callback);
+
+   return 0;
+}
+
+// Read the latest upload progress if it changed since version
+bool dfu_smp_get_progress(dfu_progress_t *value, uint32_t *version)
+{
+   return latest_mailbox_read(&dfu_progress_mailbox, value, version);
+}
+
+static void dfu_smp_report(void)
+{
+   latest_mailbox_write(&dfu_progress_mailbox, &progress);
+   app_event_post(APP_EVENT_DFU);
+}
+
+// Runs in the SMP work queue for every image chunk, before it is written
+static enum mgmt_cb_return dfu_smp_event(uint32_t event, enum mgmt_cb_return prev_status,
+                                         int32_t *rc, uint16_t *group, bool *abort_more,
+                                         void *data, size_t data_size)
+{
+   uint32_t now_ms = k_uptime_get_32();
+
+   switch (event)
+   {
+   case MGMT_EVT_OP_IMG_MGMT_DFU_CHUNK:
+   {
+      const struct img_mgmt_upload_check *check = data;
+
+      if (check->req->off == 0U)
+      {
+         dfu_progress_start(&progress, check->action->size, now_ms);
+         LOG_INF("Image upload started, %u bytes", progress.size);
+      }
+
+      if (dfu_progress_update(&progress, check->req->off + check->req->img_data.len, now_ms,
+                              CONFIG_APP_DFU_REPORT_INTERVAL_MS))
+      {
+         dfu_smp_report();
+      }
+      break;
+   }
+
+   case MGMT_EVT_OP_IMG_MGMT_DFU_PENDING:
+      dfu_progress_finish(&progress, true, now_ms);
+      LOG_INF("Image upload complete, %u bytes in %u ms (%u B/s)",
+              progress.size, progress.elapsed_ms, progress.bytes_per_s);
+      dfu_smp_report();
+      break;
+
+   case MGMT_EVT_OP_IMG_MGMT_DFU_STOPPED:
+      dfu_progress_finish(&progress, false, now_ms);
+      LOG_WRN("Image upload stopped at %u of %u bytes", progress.offset, progress.size);
+      dfu_smp_report();
+      break;
+
+   default:
+      break;
+   }
+
+   return MGMT_CB_OK;
+}
@@ -1,6 +1,11 @@
 #define _GNU_SOURCE
 
 #include "display_ssd1306.h"
+#include "msg_history.h"
+#include "watch_face.h"
+#if defined(CONFIG_APP_MSG_MARQUEE)
+#include "ssd1306_marquee.h"
+#endif
 
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
@@ -15,11 +20,32 @@ static uint8_t message_buffer[DISPLAY_MSG_BUFFER_SIZE] = "By: Charles Dias";
 static char date_str[] = {"2023/01/20 FRI"};
 static char time_str[] = {"00:00:00"};
 static const struct device *display_dev;
+// Message label of the classic face, the one the marquee takes over
 static lv_obj_t *msg_label;
-static lv_obj_t *title_label;
-static lv_obj_t *date_label;
-static lv_obj_t *time_label;
+// Sequence number of the history message on screen, 0 shows the live message
+static uint32_t browse_seq;
+static char browse_str[DISPLAY_MSG_BUFFER_SIZE + 12];
+// Status line shown instead of the messages while not empty (e.g. DFU)
+static char status_str[DISPLAY_MSG_BUFFER_SIZE];
+// Newest messages, one per line, for the message list face
+static char msg_list_str[DISPLAY_MSG_LIST_LINES * (DISPLAY_MSG_BUFFER_SIZE + 12)];
 
+#if defined(CONFIG_APP_MSG_MARQUEE)
+static char marquee_str[sizeof(browse_str)];
+static const lv_area_t marquee_area = {
+   .x1 = 0,
+   .y1 = MARQUEE_Y,
+   .x2 = MARQUEE_WIDTH - 1,
+   .y2 = MARQUEE_Y + MARQUEE_HEIGHT - 1,
+};
+
+static bool msg_ink_bit(void);
+static void marquee_release(void);
+#endif
+
+static void msg_label_refresh(void);
+static void msg_show(const char *text);
+static void msg_list_refresh(void);
 
 void display_ssd1306_init(void)
 {
@@ -30,41 +56,40 @@ void display_ssd1306_init(void)
       return;
    }
 
-   if (IS_ENABLED(CONFIG_LV_Z_POINTER_KSCAN))
-   {
-      lv_obj_t *hello_world_button;
-
-      hello_world_button = lv_btn_create(lv_scr_act());
-      lv_obj_align(hello_world_button, LV_ALIGN_CENTER, 0, 0);
-      title_label = lv_label_create(hello_world_button);
-   }
-   else
+   if (watch_face_init(display_dev, WATCH_FACE_CLASSIC) < 0)
    {
-      title_label = lv_label_create(lv_scr_act());
+      LOG_ERR("Watch face init failed");
+      return;
    }
 
-   lv_label_set_text(title_label, "BLE Watch");
-   lv_obj_align(title_label, LV_ALIGN_TOP_MID, 0, 0);
-
-   date_label = lv_label_create(lv_scr_act());
-   lv_label_set_text(date_label, date_str);
-   lv_obj_align(date_label, LV_ALIGN_TOP_LEFT, 12, 15);
-   
-   time_label = lv_label_create(lv_scr_act());
-   lv_label_set_text(time_label, time_str);
-   lv_obj_align(time_label, LV_ALIGN_TOP_LEFT, 32, 30);
+   msg_label = watch_face_get_label(WATCH_FACE_CLASSIC, WATCH_FIELD_MESSAGE);
 
-   msg_label = lv_label_create(lv_scr_act());
-   lv_label_set_text(msg_label, message_buffer);
-   lv_obj_align(msg_label, LV_ALIGN_TOP_LEFT, 0, 47);
+   watch_face_set_text(WATCH_FIELD_DATE, date_str);
+   watch_face_set_text(WATCH_FIELD_TIME, time_str);
+   watch_face_set_text(WATCH_FIELD_MESSAGE, message_buffer);
+   msg_list_refresh();
 
    lv_task_handler();
    display_blanking_off(display_dev);
+
+#if defined(CONFIG_APP_MSG_MARQUEE)
+   if (ssd1306_marquee_init(display_dev) < 0)
+   {
+      LOG_ERR("Marquee init failed");
+   }
+#endif
 }
 
 void display_ssd1306_run_handler(void)
 {
+#if defined(CONFIG_APP_MSG_MARQUEE)
+   ssd1306_marquee_process();
+#endif
    lv_task_handler();
+
+   // The handler only runs on events, flush what they changed right away
+   // instead of waiting for the next LVGL refresh period.
+   lv_refr_now(NULL);
 }
 
 const char* display_ssd1306_get_msg_string(void)
@@ -78,8 +103,181 @@ void display_ssd1306_set_msg_string(const char* msg, uint16_t size)
 
    memcpy(message_buffer, msg, size_str);
    message_buffer[size_str] = '\0';
+
+   // A new message always brings the screen back to the live message
+   browse_seq = 0U;
+
+   msg_list_refresh();
+}
+
+// Text of the status and diagnostics faces
+void display_ssd1306_set_field(uint8_t field, const char *text)
+{
+   watch_face_set_text(field, text);
+}
+
+// Switch to another watch face. The marquee only runs on the classic face,
+// where the message area is.
+void display_ssd1306_select_face(uint8_t face)
+{
+#if defined(CONFIG_APP_MSG_MARQUEE)
+   // The switch writes a whole frame over the marquee pages: stop the
+   // scroll first, it starts again below if the face is the classic one
+   if (ssd1306_marquee_is_active())
+   {
+      marquee_release();
+   }
+#endif
+
+   if (watch_face_select(face) < 0)
+   {
+      LOG_ERR("Unknown watch face %u", face);
+   }
+
+   // Back on the classic face, a message wider than the screen scrolls again
+   msg_label_refresh();
+}
+
+// Step one message back in the history. Stepping past the oldest stored
+// message returns to the live message.
+void display_ssd1306_history_browse(void)
+{
+   uint32_t oldest_seq;
+   uint32_t newest_seq;
+
+   if (msg_history_range(&oldest_seq, &newest_seq) == 0U)
+   {
+      browse_seq = 0U;
+   }
+   else if (browse_seq == 0U || browse_seq > newest_seq)
+   {
+      browse_seq = newest_seq;
+   }
+   else if (browse_seq <= oldest_seq)
+   {
+      browse_seq = 0U;
+   }
+   else
+   {
+      browse_seq--;
+   }
+
+   msg_label_refresh();
+}
+
+// Show a status line in the message area, NULL or "" returns to the messages
+void display_ssd1306_set_status(const char *status)
+{
+   strncpy(status_str, status != NULL ? status : "", sizeof(status_str) - 1);
+
+   msg_label_refresh();
 }
 
+static void msg_label_refresh(void)
+{
+   msg_history_entry_t entry;
+
+   if (status_str[0] != '\0')
+   {
+      msg_show(status_str);
+      return;
+   }
+
+   if (browse_seq != 0U && msg_history_get(browse_seq, &entry) == 0)
+   {
+      snprintf(browse_str, sizeof(browse_str), "#%u %s", entry.seq, entry.msg_buffer);
+      msg_show(browse_str);
+      return;
+   }
+
+   browse_seq = 0U;
+   msg_show(message_buffer);
+}
+
+// Newest messages first, one per line
+static void msg_list_refresh(void)
+{
+   msg_history_entry_t entry;
+   uint32_t oldest_seq;
+   uint32_t newest_seq;
+   size_t used = 0;
+
+   msg_list_str[0] = '\0';
+
+   if (msg_history_range(&oldest_seq, &newest_seq) > 0U)
+   {
+      for (uint32_t seq = newest_seq;
+           seq >= oldest_seq && newest_seq - seq < DISPLAY_MSG_LIST_LINES && used < sizeof(msg_list_str);
+           seq--)
+      {
+         if (msg_history_get(seq, &entry) == 0)
+         {
+            used += snprintf(&msg_list_str[used], sizeof(msg_list_str) - used, "%s#%u %s",
+                             used > 0U ? "\n" : "", entry.seq, entry.msg_buffer);
+         }
+      }
+   }
+
+   watch_face_set_text(WATCH_FIELD_MSG_LIST, msg_list_str);
+}
+
+// Show the text in the message area, scrolling it when wider than the screen
+static void msg_show(const char *text)
+{
+#if defined(CONFIG_APP_MSG_MARQUEE)
+   const lv_font_t *font = lv_obj_get_style_text_font(msg_label, LV_PART_MAIN);
+   lv_coord_t width = lv_txt_get_width(text, (uint32_t)strlen(text), font, 0, LV_TEXT_FLAG_NONE);
+
+   if (width > MARQUEE_WIDTH && watch_face_get_active() == WATCH_FACE_CLASSIC)
+   {
+      if (!ssd1306_marquee_is_active() || strcmp(marquee_str, text) != 0)
+      {
+         strncpy(marquee_str, text, sizeof(marquee_str) - 1);
+         lv_obj_add_flag(msg_label, LV_OBJ_FLAG_HIDDEN);
+
+         // Let LVGL clear the message area before the controller takes over
+         lv_task_handler();
+
+         if (ssd1306_marquee_start(text, font, msg_ink_bit()) < 0)
+         {
+            LOG_ERR("Marquee start failed");
+         }
+      }
+      return;
+   }
+
+   if (ssd1306_marquee_is_active())
+   {
+      marquee_release();
+   }
+#endif
+
+   watch_face_set_text(WATCH_FIELD_MESSAGE, text);
+}
+
+#if defined(CONFIG_APP_MSG_MARQUEE)
+// Give the message area back to LVGL
+static void marquee_release(void)
+{
+   ssd1306_marquee_stop();
+   lv_obj_clear_flag(msg_label, LV_OBJ_FLAG_HIDDEN);
+
+   // The scroll moved the controller RAM, LVGL has to draw the area again
+   lv_obj_invalidate_area(lv_scr_act(), &marquee_area);
+}
+
+// Pixel value of the label text, mapped the same way the LVGL mono flush does
+static bool msg_ink_bit(void)
+{
+   struct display_capabilities caps;
+   lv_color_t color = lv_obj_get_style_text_color(msg_label, LV_PART_MAIN);
+
+   display_get_capabilities(display_dev, &caps);
+
+   return (color.full == 0U) ^ (caps.current_pixel_format == PIXEL_FORMAT_MONO10);
+}
+#endif
+
 // Time format message YYYY-MM-DD HH:MM:SS DOW DOY
 void display_ssd1306_update_date_time(const char *date_time_string)
 {
@@ -106,9 +304,8 @@ void display_ssd1306_update_date_time(const char *date_time_string)
    free_space = free_space - strlen(date_dow_string);
    strncat(date_dow_string, dow_substring, free_space);
 
-   lv_label_set_text(date_label, date_dow_string);
-
-   lv_label_set_text(time_label, time_substring);
+   watch_face_set_text(WATCH_FIELD_DATE, date_dow_string);
+   watch_face_set_text(WATCH_FIELD_TIME, time_substring);
 
-   lv_label_set_text(msg_label, message_buffer);
+   msg_label_refresh();
 }
\ No newline at end of file
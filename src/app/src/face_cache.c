@@ -0,0 +1,42 @@
+#include "face_cache.h"
+
+#include <string.h>
+
+// Copy a flushed area into the frame. buf has the controller layout, with
+// rows packed in pages of the area width; y and height are multiples of 8.
+void face_cache_blit(struct face_cache *cache, const uint8_t *buf, int16_t x, int16_t y,
+                     uint16_t width, uint16_t height)
+{
+   uint16_t first_page = (uint16_t)y / 8U;
+   uint16_t pages = height / 8U;
+
+   if (x < 0 || y < 0 || x + width > FACE_CACHE_WIDTH || y + height > FACE_CACHE_HEIGHT)
+   {
+      return;
+   }
+
+   for (uint16_t page = 0; page < pages; page++)
+   {
+      memcpy(&cache->frame[(first_page + page) * FACE_CACHE_WIDTH + x], &buf[page * width], width);
+   }
+}
+
+// Record that the frame shows the given version of the item's field, drawn
+// in area
+void face_cache_mark(struct face_cache *cache, uint8_t item, uint32_t version,
+                     const face_cache_area_t *area)
+{
+   if (item >= FACE_CACHE_MAX_ITEMS)
+   {
+      return;
+   }
+
+   cache->versions[item] = version;
+   cache->areas[item] = *area;
+}
+
+// Returns true when the frame shows an older version of the item's field
+bool face_cache_is_stale(const struct face_cache *cache, uint8_t item, uint32_t version)
+{
+   return !cache->valid || item >= FACE_CACHE_MAX_ITEMS || cache->versions[item] != version;
+}
@@ -2,7 +2,14 @@
 
 #include "gatt_central.h"
 
+#include "app_event.h"
 #include "device_information_service.h"
+#include "msg_history.h"
+#include "notify_coalesce.h"
+#include "templog.h"
+#include "time_sync.h"
+#include "watch_face.h"
+#include "rtc_ds3231.h"
 
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
@@ -13,6 +20,7 @@
 #include <zephyr/bluetooth/uuid.h>
 #include <zephyr/bluetooth/gatt.h>
 #include <zephyr/bluetooth/services/bas.h>
+#include <zephyr/sys/byteorder.h>
 
 #define DEVICE_NAME CONFIG_BT_DEVICE_NAME
 #define DEVICE_NAME_LEN (sizeof(DEVICE_NAME) - 1)
@@ -20,15 +28,75 @@
 // Register module log name
 LOG_MODULE_REGISTER(Gatt, LOG_LEVEL_DBG);
 
+// Writes that change the watch state need an encrypted link, so a bonded
+// central. The latency baseline build has no pairing and accepts them.
+#if defined(CONFIG_APP_BONDING)
+#define GATT_PERM_READ_PROTECTED  BT_GATT_PERM_READ_ENCRYPT
+#define GATT_PERM_WRITE_PROTECTED BT_GATT_PERM_WRITE_ENCRYPT
+#else
+#define GATT_PERM_READ_PROTECTED  BT_GATT_PERM_READ
+#define GATT_PERM_WRITE_PROTECTED BT_GATT_PERM_WRITE
+#endif
+
 static struct k_work advertise_work;
+static struct k_work_delayable advertise_open_work;
 static struct k_work battery_level_work;
 
+// Connections open, for the status face
+static atomic_t connection_count;
+
 // Display variable
 static uint8_t ble_message_buffer[DISPLAY_MSG_BUFFER_SIZE];
 
-struct k_msgq display_msg_queue;
+MPSC_QUEUE_DEFINE(display_msg_queue, sizeof(display_msg_t), CONFIG_APP_DISPLAY_MSG_QUEUE_SIZE);
+
+// Message history page of each connection, kept for the Read Blob requests
+// of a long read, and the next sequence to be read
+#define HISTORY_PAGE_BUF_SIZE MAX(CONFIG_BT_L2CAP_TX_MTU, MSG_HISTORY_PAGE_MIN_SIZE)
+static uint8_t history_page[CONFIG_BT_MAX_CONN][HISTORY_PAGE_BUF_SIZE];
+static uint16_t history_page_size[CONFIG_BT_MAX_CONN];
+static uint32_t history_cursor[CONFIG_BT_MAX_CONN];
+
+// Rate limited notifications of the display and time characteristics
+static struct notify_coalesce display_notify;
+static struct notify_coalesce time_notify;
+static struct notify_coalesce time_sync_notify;
+
+// Temperature log bulk transfer, one connection at a time
+#define TEMPLOG_TX_RETRY_MS   10
+#define TEMPLOG_TX_STOP       0xFFFFFFFFU
+
+static struct k_work_delayable templog_tx_work;
+static struct bt_conn *templog_tx_conn;
+static uint32_t templog_tx_offset;
+// Start of the transfer, for the throughput log
+static uint32_t templog_tx_start_offset;
+static int64_t templog_tx_start_ms;
+static atomic_t templog_tx_inflight;
+static uint8_t templog_tx_buf[CONFIG_BT_L2CAP_TX_MTU];
+
+static void templog_tx_stop(void);
+
+// Latency from a connection to its first write, for bonded peers and for
+// centrals without a bond. With bonding the latter pair first; in the
+// baseline build (CONFIG_APP_BONDING=n) they connect as before bonding was
+// added, with service discovery and no pairing, which is the figure to
+// compare the bonded reconnections with.
+struct conn_latency
+{
+   uint32_t count;
+   uint32_t total_ms;
+};
+
+static uint32_t conn_start_ms[CONFIG_BT_MAX_CONN];
+static bool conn_first_write_pending[CONFIG_BT_MAX_CONN];
+static struct conn_latency conn_latency_unbonded;
+static struct conn_latency conn_latency_bonded;
 
-K_MSGQ_DEFINE(display_msg_queue, sizeof(display_msg_t), 2, 1);
+static void conn_latency_first_write(struct bt_conn *conn);
+
+// One MTU exchange per connection
+static struct bt_gatt_exchange_params mtu_exchange_params[CONFIG_BT_MAX_CONN];
 
 // Bluetooth advertisement
 static const struct bt_data ad[] = {
@@ -53,6 +121,46 @@ static struct bt_uuid_128 display_charac_uuid =
                      0x75, 0xE2,
                      0x61, 0x4D, 0x13, 0x3C);
 
+// Characteristics: Message history UUID 3C134D62-E275-406D-B6B4-BF0CC712CB7C
+static struct bt_uuid_128 history_charac_uuid =
+    BT_UUID_INIT_128(0x7C, 0xCB, 0x12, 0xC7, 0x0C, 0xBF,
+                     0xB4, 0xB6,
+                     0x6D, 0x40,
+                     0x75, 0xE2,
+                     0x62, 0x4D, 0x13, 0x3C);
+
+// Characteristics: Current time UUID 3C134D63-E275-406D-B6B4-BF0CC712CB7C
+static struct bt_uuid_128 time_charac_uuid =
+    BT_UUID_INIT_128(0x7C, 0xCB, 0x12, 0xC7, 0x0C, 0xBF,
+                     0xB4, 0xB6,
+                     0x6D, 0x40,
+                     0x75, 0xE2,
+                     0x63, 0x4D, 0x13, 0x3C);
+
+// Characteristics: Time sync UUID 3C134D64-E275-406D-B6B4-BF0CC712CB7C
+static struct bt_uuid_128 time_sync_charac_uuid =
+    BT_UUID_INIT_128(0x7C, 0xCB, 0x12, 0xC7, 0x0C, 0xBF,
+                     0xB4, 0xB6,
+                     0x6D, 0x40,
+                     0x75, 0xE2,
+                     0x64, 0x4D, 0x13, 0x3C);
+
+// Characteristics: Temperature log UUID 3C134D65-E275-406D-B6B4-BF0CC712CB7C
+static struct bt_uuid_128 templog_charac_uuid =
+    BT_UUID_INIT_128(0x7C, 0xCB, 0x12, 0xC7, 0x0C, 0xBF,
+                     0xB4, 0xB6,
+                     0x6D, 0x40,
+                     0x75, 0xE2,
+                     0x65, 0x4D, 0x13, 0x3C);
+
+// Characteristics: Watch face UUID 3C134D66-E275-406D-B6B4-BF0CC712CB7C
+static struct bt_uuid_128 watch_face_charac_uuid =
+    BT_UUID_INIT_128(0x7C, 0xCB, 0x12, 0xC7, 0x0C, 0xBF,
+                     0xB4, 0xB6,
+                     0x6D, 0x40,
+                     0x75, 0xE2,
+                     0x66, 0x4D, 0x13, 0x3C);
+
 // Display read
 ssize_t display_msg_read(struct bt_conn *conn,
                          const struct bt_gatt_attr *attr, void *buf,
@@ -75,20 +183,337 @@ ssize_t display_msg_write(struct bt_conn *conn,
    const uint16_t buffer_size = sizeof(display_msg_buffer.msg_buffer);
    uint16_t size_str = len >= buffer_size ? buffer_size - 1 : len; 
 
+   conn_latency_first_write(conn);
+
    memcpy(display_msg_buffer.msg_buffer, buf, size_str);
    display_msg_buffer.msg_buffer[size_str] = '\0';
 
-   while (k_msgq_put(&display_msg_queue, &display_msg_buffer, K_NO_WAIT) != 0)
+   // The event loop preempts this thread as soon as the event is posted and
+   // redraws the message list, so the history must hold the message first
+   msg_history_add(display_msg_buffer.msg_buffer, size_str, rtc_ds3231_get_last_timestamp());
+
+   // Queue full: let the central know so it can back off and retry
+   if (mpsc_queue_put(&display_msg_queue, &display_msg_buffer) != 0)
    {
-      /* message queue is full: purge old data & try again */
-      k_msgq_purge(&display_msg_queue);
+      LOG_WRN("Display queue full, message rejected");
+      return BT_GATT_ERR(BT_ATT_ERR_INSUFFICIENT_RESOURCES);
    }
 
+   app_event_post(APP_EVENT_DISPLAY_MSG);
+
    LOG_DBG("Received message size %u: %s", len, display_msg_buffer.msg_buffer);
 
    return len;
 }
 
+// Current display message, used by the notifications
+static uint16_t display_msg_value(uint8_t *buf, uint16_t size)
+{
+   const char *msg_buffer = display_ssd1306_get_msg_string();
+   uint16_t len = MIN((uint16_t)strlen(msg_buffer), size);
+
+   memcpy(buf, msg_buffer, len);
+
+   return len;
+}
+
+// Current time, seconds since the epoch (u32, little endian)
+static uint16_t time_value(uint8_t *buf, uint16_t size)
+{
+   if (size < sizeof(uint32_t))
+   {
+      return 0;
+   }
+
+   sys_put_le32(rtc_ds3231_get_last_timestamp(), buf);
+
+   return sizeof(uint32_t);
+}
+
+// Time read
+ssize_t time_read(struct bt_conn *conn,
+                  const struct bt_gatt_attr *attr, void *buf,
+                  uint16_t len, uint16_t offset)
+{
+   uint8_t value[sizeof(uint32_t)];
+
+   time_value(value, sizeof(value));
+
+   return bt_gatt_attr_read(conn, attr, buf, len, offset, value, sizeof(value));
+}
+
+// Time between the start of the connection event carrying a write of len
+// bytes and the write reaching the host: air time of the PDU plus the
+// controller to host latency.
+static uint32_t time_sync_link_delay_us(struct bt_conn *conn, uint16_t len)
+{
+   uint32_t preamble = 1U;
+   uint32_t us_per_byte = 8U;
+   uint32_t mic = 0U;
+
+#if defined(CONFIG_BT_USER_PHY_UPDATE)
+   struct bt_conn_info info;
+
+   if (bt_conn_get_info(conn, &info) == 0 && info.le.phy != NULL &&
+       info.le.phy->rx_phy == BT_GAP_LE_PHY_2M)
+   {
+      preamble = 2U;
+      us_per_byte = 4U;
+   }
+#endif
+
+#if defined(CONFIG_BT_SMP)
+   // Encrypted PDUs carry a 4 byte MIC after the payload
+   if (bt_conn_get_security(conn) >= BT_SECURITY_L2)
+   {
+      mic = 4U;
+   }
+#endif
+
+   // Preamble, access address, LL header, L2CAP header, ATT header, value, MIC and CRC
+   uint32_t pdu_bytes = preamble + 4U + 2U + 4U + 3U + len + mic + 3U;
+
+   return pdu_bytes * us_per_byte + CONFIG_APP_TIME_SYNC_RX_LATENCY_US;
+}
+
+// Time sync write
+// Receives the phone time (u32 seconds, u32 microseconds, little endian)
+// taken at the start of the connection event that carries the write.
+ssize_t time_sync_write(struct bt_conn *conn,
+                        const struct bt_gatt_attr *attr, const void *buf,
+                        uint16_t len, uint16_t offset, uint8_t flags)
+{
+   // Timestamp the request before anything else
+   uint32_t syncclock = time_sync_capture();
+   const uint8_t *data = buf;
+
+   conn_latency_first_write(conn);
+
+   if (offset != 0U)
+   {
+      return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+   }
+
+   if (len != TIME_SYNC_REQUEST_SIZE)
+   {
+      return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+   }
+
+   int err = time_sync_request(sys_get_le32(&data[0]), sys_get_le32(&data[4]),
+                               syncclock, time_sync_link_delay_us(conn, len));
+
+   if (err == -EBUSY)
+   {
+      return BT_GATT_ERR(BT_ATT_ERR_PROCEDURE_IN_PROGRESS);
+   }
+   else if (err < 0)
+   {
+      return BT_GATT_ERR(BT_ATT_ERR_UNLIKELY);
+   }
+
+   return len;
+}
+
+// Time sync read, returns the result of the last synchronization
+ssize_t time_sync_read(struct bt_conn *conn,
+                       const struct bt_gatt_attr *attr, void *buf,
+                       uint16_t len, uint16_t offset)
+{
+   uint8_t value[TIME_SYNC_RESULT_SIZE];
+   uint16_t size = time_sync_encode_result(value, sizeof(value));
+
+   return bt_gatt_attr_read(conn, attr, buf, len, offset, value, size);
+}
+
+static void time_sync_done(void)
+{
+   notify_coalesce_changed(&time_sync_notify);
+}
+
+// Temperature log read
+// Returns the stream range available: start offset (u32), end offset (u32)
+// and sampling period in seconds (u16), little endian.
+ssize_t templog_charac_read(struct bt_conn *conn,
+                            const struct bt_gatt_attr *attr, void *buf,
+                            uint16_t len, uint16_t offset)
+{
+   uint8_t value[10];
+   uint32_t start_offset;
+   uint32_t end_offset;
+
+   templog_get_range(&start_offset, &end_offset);
+
+   sys_put_le32(start_offset, &value[0]);
+   sys_put_le32(end_offset, &value[4]);
+   sys_put_le16(CONFIG_APP_TEMPLOG_PERIOD_S, &value[8]);
+
+   return bt_gatt_attr_read(conn, attr, buf, len, offset, value, sizeof(value));
+}
+
+// Temperature log write
+// Starts streaming the log from the given stream offset (u32, little endian)
+// as notifications. TEMPLOG_TX_STOP stops the transfer.
+ssize_t templog_charac_write(struct bt_conn *conn,
+                             const struct bt_gatt_attr *attr, const void *buf,
+                             uint16_t len, uint16_t offset, uint8_t flags)
+{
+   conn_latency_first_write(conn);
+
+   if (offset != 0U)
+   {
+      return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+   }
+
+   if (len != sizeof(uint32_t))
+   {
+      return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+   }
+
+   uint32_t start_offset = sys_get_le32(buf);
+
+   if (templog_tx_conn != NULL && templog_tx_conn != conn)
+   {
+      return BT_GATT_ERR(BT_ATT_ERR_PROCEDURE_IN_PROGRESS);
+   }
+
+   if (start_offset == TEMPLOG_TX_STOP)
+   {
+      templog_tx_stop();
+      return len;
+   }
+
+   if (!bt_gatt_is_subscribed(conn, attr, BT_GATT_CCC_NOTIFY))
+   {
+      return BT_GATT_ERR(BT_ATT_ERR_CCC_IMPROPER_CONF);
+   }
+
+   if (templog_tx_conn == NULL)
+   {
+      templog_tx_conn = bt_conn_ref(conn);
+   }
+
+   templog_tx_offset = start_offset;
+   templog_tx_start_offset = start_offset;
+   templog_tx_start_ms = k_uptime_get();
+   k_work_reschedule(&templog_tx_work, K_NO_WAIT);
+
+   LOG_INF("Temperature log transfer from offset %u", start_offset);
+
+   return len;
+}
+
+// Watch face read
+// Returns the face on screen (u8) and the number of faces (u8).
+ssize_t watch_face_read(struct bt_conn *conn,
+                        const struct bt_gatt_attr *attr, void *buf,
+                        uint16_t len, uint16_t offset)
+{
+   uint8_t value[2] = { watch_face_get_active(), WATCH_FACE_COUNT };
+
+   return bt_gatt_attr_read(conn, attr, buf, len, offset, value, sizeof(value));
+}
+
+// Watch face write
+// Selects the face (u8), the event loop switches to it.
+ssize_t watch_face_write(struct bt_conn *conn,
+                         const struct bt_gatt_attr *attr, const void *buf,
+                         uint16_t len, uint16_t offset, uint8_t flags)
+{
+   const uint8_t *face = buf;
+
+   conn_latency_first_write(conn);
+
+   if (offset != 0U)
+   {
+      return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+   }
+
+   if (len != sizeof(uint8_t))
+   {
+      return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+   }
+
+   if (*face >= WATCH_FACE_COUNT)
+   {
+      return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+   }
+
+   watch_face_request(*face);
+
+   return len;
+}
+
+static void ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+   LOG_DBG("CCC changed: 0x%04x", value);
+}
+
+// Message history read
+// A read at offset 0 encodes a page with as many messages as fit in one ATT
+// response, starting at the connection cursor, and moves the cursor past the
+// last message of the page. The page is never smaller than one full message:
+// when that is more than one response, the client fetches the rest of the
+// same page with Read Blob requests at the following offsets.
+ssize_t history_read(struct bt_conn *conn,
+                     const struct bt_gatt_attr *attr, void *buf,
+                     uint16_t len, uint16_t offset)
+{
+   uint8_t conn_index = bt_conn_index(conn);
+
+   if (offset == 0U)
+   {
+      uint32_t start_seq = history_cursor[conn_index];
+      uint16_t page_size = MAX(MIN(bt_gatt_get_mtu(conn) - 1U, HISTORY_PAGE_BUF_SIZE),
+                               MSG_HISTORY_PAGE_MIN_SIZE);
+      size_t size = msg_history_encode_page(start_seq, history_page[conn_index], page_size);
+
+      if (size == 0U)
+      {
+         return BT_GATT_ERR(BT_ATT_ERR_UNLIKELY);
+      }
+
+      uint32_t oldest_seq = sys_get_le32(&history_page[conn_index][0]);
+      uint8_t entries = history_page[conn_index][8];
+
+      if (entries > 0U)
+      {
+         history_cursor[conn_index] = MAX(start_seq, oldest_seq) + entries;
+      }
+
+      history_page_size[conn_index] = (uint16_t)size;
+
+      LOG_DBG("Read history from #%u: %u messages", start_seq, entries);
+   }
+
+   return bt_gatt_attr_read(conn, attr, buf, len, offset, history_page[conn_index],
+                            history_page_size[conn_index]);
+}
+
+// Message history write
+// Sets the sequence number (u32, little endian) of the next message to be read.
+ssize_t history_write(struct bt_conn *conn,
+                      const struct bt_gatt_attr *attr, const void *buf,
+                      uint16_t len, uint16_t offset, uint8_t flags)
+{
+   conn_latency_first_write(conn);
+
+   if (offset != 0U)
+   {
+      return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+   }
+
+   if (len != sizeof(uint32_t))
+   {
+      return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+   }
+
+   history_cursor[bt_conn_index(conn)] = sys_get_le32(buf);
+
+   LOG_DBG("History cursor set to #%u", history_cursor[bt_conn_index(conn)]);
+
+   return len;
+}
+
 // Instantiate the Service and its characteristics
 BT_GATT_SERVICE_DEFINE(
     ble_watch,
@@ -97,15 +522,228 @@ BT_GATT_SERVICE_DEFINE(
     BT_GATT_PRIMARY_SERVICE(&ble_watch_service_uuid),
 
     // Display characteristics
-    // Properties: Read, Write
+    // Properties: Read, Write, Notify, Indicate
     BT_GATT_CHARACTERISTIC(&display_charac_uuid.uuid,
-                           BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
+                           BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE |
+                           BT_GATT_CHRC_NOTIFY | BT_GATT_CHRC_INDICATE,
                            BT_GATT_PERM_READ | BT_GATT_PERM_WRITE,
                            display_msg_read,
                            display_msg_write,
-                           ble_message_buffer));
+                           ble_message_buffer),
+    BT_GATT_CCC(ccc_cfg_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+
+    // Message history characteristics
+    // Properties: Read, Write
+    BT_GATT_CHARACTERISTIC(&history_charac_uuid.uuid,
+                           BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
+                           BT_GATT_PERM_READ | BT_GATT_PERM_WRITE,
+                           history_read,
+                           history_write,
+                           NULL),
+
+    // Current time characteristics
+    // Properties: Read, Notify, Indicate
+    BT_GATT_CHARACTERISTIC(&time_charac_uuid.uuid,
+                           BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY | BT_GATT_CHRC_INDICATE,
+                           BT_GATT_PERM_READ,
+                           time_read,
+                           NULL,
+                           NULL),
+    BT_GATT_CCC(ccc_cfg_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+
+    // Time sync characteristics
+    // Properties: Read, Write, Notify, Indicate
+    BT_GATT_CHARACTERISTIC(&time_sync_charac_uuid.uuid,
+                           BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE |
+                           BT_GATT_CHRC_NOTIFY | BT_GATT_CHRC_INDICATE,
+                           BT_GATT_PERM_READ | GATT_PERM_WRITE_PROTECTED,
+                           time_sync_read,
+                           time_sync_write,
+                           NULL),
+    BT_GATT_CCC(ccc_cfg_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+
+    // Temperature log characteristics
+    // Properties: Read, Write, Notify
+    BT_GATT_CHARACTERISTIC(&templog_charac_uuid.uuid,
+                           BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE | BT_GATT_CHRC_NOTIFY,
+                           BT_GATT_PERM_READ | BT_GATT_PERM_WRITE,
+                           templog_charac_read,
+                           templog_charac_write,
+                           NULL),
+    BT_GATT_CCC(ccc_cfg_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+
+    // Watch face characteristics
+    // Properties: Read, Write
+    BT_GATT_CHARACTERISTIC(&watch_face_charac_uuid.uuid,
+                           BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
+                           GATT_PERM_READ_PROTECTED | GATT_PERM_WRITE_PROTECTED,
+                           watch_face_read,
+                           watch_face_write,
+                           NULL));
+
+static void templog_tx_done(struct bt_conn *conn, void *user_data)
+{
+   atomic_dec(&templog_tx_inflight);
+   k_work_reschedule(&templog_tx_work, K_NO_WAIT);
+}
+
+// Stream the log as notifications of [stream offset (u32) | log bytes],
+// keeping CONFIG_APP_TEMPLOG_TX_INFLIGHT of them queued in the stack. A
+// notification with the offset only marks the end of the log.
+// Runs in the system work queue, like the temperature sampling.
+static void templog_tx_handler(struct k_work *work)
+{
+   const struct bt_gatt_attr *attr = bt_gatt_find_by_uuid(ble_watch.attrs, ble_watch.attr_count,
+                                                          &templog_charac_uuid.uuid);
+
+   while (templog_tx_conn != NULL && atomic_get(&templog_tx_inflight) < CONFIG_APP_TEMPLOG_TX_INFLIGHT)
+   {
+      uint16_t payload = MIN(bt_gatt_get_mtu(templog_tx_conn) - 3U, sizeof(templog_tx_buf));
+      uint32_t read_offset = templog_tx_offset;
+      int size = templog_read(templog_tx_offset, &templog_tx_buf[4], payload - 4U, &read_offset);
+
+      if (size < 0)
+      {
+         LOG_ERR("Temperature log read failed (err %d)", size);
+         templog_tx_stop();
+         return;
+      }
+
+      struct bt_gatt_notify_params params = {
+         .attr = attr,
+         .data = templog_tx_buf,
+         .len = 4U + (uint16_t)size,
+         .func = templog_tx_done,
+      };
+
+      sys_put_le32(size ? read_offset : templog_tx_offset, templog_tx_buf);
+
+      int err = bt_gatt_notify_cb(templog_tx_conn, &params);
+
+      if (err == -ENOMEM)
+      {
+         // No buffer available, a completion reschedules the transfer
+         if (atomic_get(&templog_tx_inflight) == 0)
+         {
+            k_work_reschedule(&templog_tx_work, K_MSEC(TEMPLOG_TX_RETRY_MS));
+         }
+         return;
+      }
+      else if (err)
+      {
+         LOG_ERR("Temperature log notify failed (err %d)", err);
+         templog_tx_stop();
+         return;
+      }
+
+      atomic_inc(&templog_tx_inflight);
+
+      // templog_read() skips the gaps, so nothing read is the real end
+      if (size == 0)
+      {
+         uint32_t bytes = templog_tx_offset - templog_tx_start_offset;
+         uint32_t elapsed_ms = (uint32_t)MAX(k_uptime_get() - templog_tx_start_ms, 1);
+
+         LOG_INF("Temperature log transfer complete at offset %u: %u bytes in %u ms, %u B/s",
+                 templog_tx_offset, bytes, elapsed_ms, (uint32_t)((uint64_t)bytes * 1000U / elapsed_ms));
+         templog_tx_stop();
+         return;
+      }
+
+      // The first block sent may start after a dropped start offset
+      if (templog_tx_offset == templog_tx_start_offset)
+      {
+         templog_tx_start_offset = read_offset;
+      }
+
+      templog_tx_offset = read_offset + (uint32_t)size;
+   }
+}
+
+static void templog_tx_stop(void)
+{
+   if (templog_tx_conn != NULL)
+   {
+      bt_conn_unref(templog_tx_conn);
+      templog_tx_conn = NULL;
+   }
+}
 
 // Connected callback function
+static void conn_latency_first_write(struct bt_conn *conn)
+{
+   uint8_t index = bt_conn_index(conn);
+
+   if (!conn_first_write_pending[index])
+   {
+      return;
+   }
+
+   conn_first_write_pending[index] = false;
+
+   // The peer address is its identity once the link is encrypted
+   bool bonded = bt_addr_le_is_bonded(BT_ID_DEFAULT, bt_conn_get_dst(conn));
+   struct conn_latency *latency = bonded ? &conn_latency_bonded : &conn_latency_unbonded;
+   uint32_t latency_ms = k_uptime_get_32() - conn_start_ms[index];
+   const char *peer = bonded ? "bonded" :
+                      IS_ENABLED(CONFIG_APP_BONDING) ? "pairing" : "baseline";
+
+   latency->count++;
+   latency->total_ms += latency_ms;
+
+   LOG_INF("First write %u ms after connection, %s peer (average %u ms over %u)",
+           latency_ms, peer, latency->total_ms / latency->count, latency->count);
+}
+
+static void mtu_exchanged(struct bt_conn *conn, uint8_t err,
+                          struct bt_gatt_exchange_params *params)
+{
+   if (err)
+   {
+      LOG_WRN("MTU exchange failed (err %u)", err);
+      return;
+   }
+
+   LOG_INF("ATT MTU %u", bt_gatt_get_mtu(conn));
+}
+
+// Ask for the fastest link: 2M PHY, the longest link layer packets and the
+// largest ATT MTU, which SMP image uploads and the temperature log download
+// fill. The central may refuse any of them.
+static void conn_throughput_request(struct bt_conn *conn)
+{
+   struct bt_gatt_exchange_params *params = &mtu_exchange_params[bt_conn_index(conn)];
+   int err = bt_conn_le_phy_update(conn, BT_CONN_LE_PHY_PARAM_2M);
+
+   if (err)
+   {
+      LOG_WRN("PHY update request failed (err %d)", err);
+   }
+
+   err = bt_conn_le_data_len_update(conn, BT_LE_DATA_LEN_PARAM_MAX);
+   if (err)
+   {
+      LOG_WRN("Data length update request failed (err %d)", err);
+   }
+
+   params->func = mtu_exchanged;
+   err = bt_gatt_exchange_mtu(conn, params);
+   if (err)
+   {
+      LOG_DBG("MTU exchange not started (err %d)", err);
+   }
+}
+
+static void le_phy_updated(struct bt_conn *conn, struct bt_conn_le_phy_info *param)
+{
+   LOG_INF("PHY TX %u RX %u", param->tx_phy, param->rx_phy);
+}
+
+static void le_data_len_updated(struct bt_conn *conn, struct bt_conn_le_data_len_info *info)
+{
+   LOG_INF("Data length TX %u bytes, RX %u bytes", info->tx_max_len, info->rx_max_len);
+}
+
 static void connected(struct bt_conn *conn, uint8_t err)
 {
    if (err)
@@ -114,14 +752,82 @@ static void connected(struct bt_conn *conn, uint8_t err)
    }
    else
    {
+      uint8_t index = bt_conn_index(conn);
+
+      k_work_cancel_delayable(&advertise_open_work);
+
+      // New connections read the history from the oldest message
+      history_cursor[index] = 0U;
+      history_page_size[index] = 0U;
+      conn_start_ms[index] = k_uptime_get_32();
+      conn_first_write_pending[index] = true;
+      atomic_inc(&connection_count);
       LOG_INF("Connection successful!");
+
+#if defined(CONFIG_APP_BONDING)
+      // Encrypt the link: bonded peers restore their keys, others pair
+      // and bond (Just Works)
+      err = bt_conn_set_security(conn, BT_SECURITY_L2);
+      if (err)
+      {
+         LOG_ERR("Failed to set security (err %d)", err);
+      }
+#endif
+
+      conn_throughput_request(conn);
+   }
+}
+
+#if defined(CONFIG_APP_BONDING)
+static void security_changed(struct bt_conn *conn, bt_security_t level,
+                             enum bt_security_err err)
+{
+   if (err)
+   {
+      LOG_WRN("Security failed: level %u (err %d)", level, err);
+      return;
    }
+
+   LOG_INF("Security level %u, %u ms after connection",
+           level, k_uptime_get_32() - conn_start_ms[bt_conn_index(conn)]);
+}
+
+static void pairing_complete(struct bt_conn *conn, bool bonded)
+{
+   LOG_INF("Pairing complete, %s", bonded ? "bonded" : "not bonded");
+}
+
+static void pairing_failed(struct bt_conn *conn, enum bt_security_err reason)
+{
+   LOG_WRN("Pairing failed (reason %d)", reason);
 }
 
+static struct bt_conn_auth_info_cb auth_info_callbacks = {
+    .pairing_complete = pairing_complete,
+    .pairing_failed = pairing_failed,
+};
+#endif
+
 // Disconnected callback function
 static void disconnected(struct bt_conn *conn, uint8_t reason)
 {
    LOG_INF("Disconnected (reason 0x%02x)", reason);
+
+   atomic_dec(&connection_count);
+
+   notify_coalesce_conn_reset(&display_notify, conn);
+   notify_coalesce_conn_reset(&time_notify, conn);
+   notify_coalesce_conn_reset(&time_sync_notify, conn);
+
+   if (conn == templog_tx_conn)
+   {
+      templog_tx_stop();
+   }
+
+   LOG_INF("Display notifications sent %u, suppressed %u",
+           notify_coalesce_sent(&display_notify), notify_coalesce_suppressed(&display_notify));
+   LOG_INF("Time notifications sent %u, suppressed %u",
+           notify_coalesce_sent(&time_notify), notify_coalesce_suppressed(&time_notify));
    k_work_submit(&advertise_work);
 }
 
@@ -129,23 +835,86 @@ static void disconnected(struct bt_conn *conn, uint8_t reason)
 BT_CONN_CB_DEFINE(conn_callbacks) = {
     .connected = connected,
     .disconnected = disconnected,
+#if defined(CONFIG_APP_BONDING)
+    .security_changed = security_changed,
+#endif
+    .le_phy_updated = le_phy_updated,
+    .le_data_len_updated = le_data_len_updated,
 };
 
-static void advertise(struct k_work *work)
+#if defined(CONFIG_APP_BONDING)
+static void accept_list_add_bond(const struct bt_bond_info *info, void *user_data)
 {
-   int err;
+   uint8_t *bond_count = user_data;
+   int err = bt_le_filter_accept_list_add(&info->addr);
+
+   if (err)
+   {
+      LOG_ERR("Failed to add a bond to the accept list (err %d)", err);
+      return;
+   }
+
+   (*bond_count)++;
+}
+#endif
+
+static int advertise_start(bool accept_list)
+{
+   struct bt_le_adv_param param = *BT_LE_ADV_CONN;
+   uint8_t bond_count = 0U;
 
    bt_le_adv_stop();
 
-   err = bt_le_adv_start(BT_LE_ADV_CONN, ad, ARRAY_SIZE(ad), NULL, 0);
+#if defined(CONFIG_APP_BONDING)
+   bt_le_filter_accept_list_clear();
+
+   if (accept_list)
+   {
+      bt_foreach_bond(BT_ID_DEFAULT, accept_list_add_bond, &bond_count);
+   }
+#endif
+
+   if (bond_count > 0U)
+   {
+      // Only bonded peers may connect, at the fastest interval while
+      // the window lasts
+      param.options |= BT_LE_ADV_OPT_FILTER_CONN;
+      param.interval_min = BT_GAP_ADV_FAST_INT_MIN_1;
+      param.interval_max = BT_GAP_ADV_FAST_INT_MAX_1;
+   }
+
+   int err = bt_le_adv_start(&param, ad, ARRAY_SIZE(ad), NULL, 0);
 
    if (err)
    {
       LOG_ERR("Advertising failed to start (rc %d)", err);
-      return;
+      return err;
+   }
+
+   if (bond_count > 0U)
+   {
+      LOG_INF("Advertising to %u bonded peers", bond_count);
+      return 1;
    }
 
    LOG_INF("Advertising successfully started");
+
+   return 0;
+}
+
+// After a disconnection, advertise to the bonded peers first
+static void advertise(struct k_work *work)
+{
+   if (advertise_start(CONFIG_APP_ADV_ACCEPT_LIST_S > 0) > 0)
+   {
+      k_work_reschedule(&advertise_open_work, K_SECONDS(CONFIG_APP_ADV_ACCEPT_LIST_S));
+   }
+}
+
+// Window for bonded peers elapsed, let new centrals connect
+static void advertise_open(struct k_work *work)
+{
+   advertise_start(false);
 }
 
 // Implements the battery level notification
@@ -168,8 +937,23 @@ int gatt_central_bt_start_advertising(void)
    int err = 0;
 
    k_work_init(&advertise_work, advertise);
+   k_work_init_delayable(&advertise_open_work, advertise_open);
    k_work_init(&battery_level_work, battery_level_notify);
 
+   notify_coalesce_init(&display_notify,
+                        bt_gatt_find_by_uuid(ble_watch.attrs, ble_watch.attr_count, &display_charac_uuid.uuid),
+                        display_msg_value);
+   notify_coalesce_init(&time_notify,
+                        bt_gatt_find_by_uuid(ble_watch.attrs, ble_watch.attr_count, &time_charac_uuid.uuid),
+                        time_value);
+   notify_coalesce_init(&time_sync_notify,
+                        bt_gatt_find_by_uuid(ble_watch.attrs, ble_watch.attr_count, &time_sync_charac_uuid.uuid),
+                        time_sync_encode_result);
+
+   time_sync_init(time_sync_done);
+
+   k_work_init_delayable(&templog_tx_work, templog_tx_handler);
+
    // Enable Bluetooth
    err = bt_enable(NULL);
    if (err)
@@ -178,7 +962,15 @@ int gatt_central_bt_start_advertising(void)
       return EXIT_FAILURE;
    }
 
-   // Setting the device information
+#if defined(CONFIG_APP_BONDING)
+   err = bt_conn_auth_info_cb_register(&auth_info_callbacks);
+   if (err)
+   {
+      LOG_ERR("Failed to register authorization info callbacks (err %d)", err);
+   }
+#endif
+
+   // Setting the device information, this also loads the bonds
    set_device_information_runtime();
 
    LOG_DBG("Bluetooth initialized");
@@ -192,4 +984,30 @@ int gatt_central_bt_start_advertising(void)
 void gatt_server_battery_level_notify(void)
 {
    k_work_submit(&battery_level_work);
-}
\ No newline at end of file
+}
+
+void gatt_server_display_msg_notify(void)
+{
+   notify_coalesce_changed(&display_notify);
+}
+
+void gatt_server_time_notify(void)
+{
+   notify_coalesce_changed(&time_notify);
+}
+
+void gatt_server_get_notify_stats(uint32_t *sent, uint32_t *suppressed)
+{
+   *sent = notify_coalesce_sent(&display_notify) + notify_coalesce_sent(&time_notify);
+   *suppressed = notify_coalesce_suppressed(&display_notify) + notify_coalesce_suppressed(&time_notify);
+}
+
+uint8_t gatt_server_connection_count(void)
+{
+   return (uint8_t)atomic_get(&connection_count);
+}
+
+uint8_t gatt_server_battery_level(void)
+{
+   return bt_bas_get_battery_level();
+}
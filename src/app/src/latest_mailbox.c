@@ -0,0 +1,59 @@
+#include "latest_mailbox.h"
+
+#include <zephyr/kernel.h>
+#include <string.h>
+
+// Publish a new value. Must always be called from the same thread.
+void latest_mailbox_write(struct latest_mailbox *mb, const void *value)
+{
+   // No reader thread may run while the sequence is odd
+   k_sched_lock();
+
+   // Odd sequence: write in progress
+   (void)atomic_inc(&mb->seq);
+
+   memcpy(mb->data, value, mb->size);
+
+   // Even sequence: value complete
+   (void)atomic_inc(&mb->seq);
+
+   k_sched_unlock();
+}
+
+// Copy the newest value.
+// version holds the version the caller already has (0 for none) and is
+// updated with the version copied. Returns false, without copying, when
+// nothing was published since that version.
+bool latest_mailbox_read(struct latest_mailbox *mb, void *value, uint32_t *version)
+{
+   uint32_t start;
+   uint32_t end = 0U;
+
+   do
+   {
+      start = (uint32_t)atomic_get(&mb->seq);
+
+      if (start == *version)
+      {
+         return false;
+      }
+
+      // Writer in the middle of an update
+      if (start & 1U)
+      {
+         k_yield();
+         continue;
+      }
+
+      memcpy(value, mb->data, mb->size);
+
+      // Keep the copy above from being moved after the second sequence read
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+      end = (uint32_t)atomic_get(&mb->seq);
+   } while ((start & 1U) || start != end);
+
+   *version = start;
+
+   return true;
+}
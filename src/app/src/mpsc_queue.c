@@ -0,0 +1,84 @@
+#include "mpsc_queue.h"
+
+#include <errno.h>
+#include <string.h>
+
+// Slot i is free for the producer at position pos when its sequence equals
+// pos and holds an item for the consumer when it equals pos + 1. Sequences
+// are stored relative to the slot index, so the zero initialized queue is
+// the empty one.
+static inline uint32_t slot_seq(const struct mpsc_queue *q, uint32_t index)
+{
+   return (uint32_t)atomic_get(&q->turn[index]) + index;
+}
+
+static inline void slot_seq_set(struct mpsc_queue *q, uint32_t index, uint32_t seq)
+{
+   (void)atomic_set(&q->turn[index], (atomic_val_t)(seq - index));
+}
+
+// Add an item. Never blocks.
+// Returns 0 on success or -ENOMEM when the queue is full.
+int mpsc_queue_put(struct mpsc_queue *q, const void *item)
+{
+   uint32_t pos = (uint32_t)atomic_get(&q->head);
+   uint32_t index;
+
+   for (;;)
+   {
+      index = pos & q->mask;
+
+      int32_t diff = (int32_t)(slot_seq(q, index) - pos);
+
+      if (diff == 0)
+      {
+         // Slot free: claim the position
+         if (atomic_cas(&q->head, (atomic_val_t)pos, (atomic_val_t)(pos + 1U)))
+         {
+            break;
+         }
+      }
+      else if (diff < 0)
+      {
+         // Slot still holds the item of the previous lap
+         (void)atomic_inc(&q->dropped);
+         return -ENOMEM;
+      }
+
+      pos = (uint32_t)atomic_get(&q->head);
+   }
+
+   memcpy(&q->buffer[index * q->item_size], item, q->item_size);
+
+   // Hand the slot to the consumer
+   slot_seq_set(q, index, pos + 1U);
+
+   return 0;
+}
+
+// Remove the oldest item. Must always be called from the same context.
+// Returns 0 on success or -EAGAIN when the queue is empty.
+int mpsc_queue_get(struct mpsc_queue *q, void *item)
+{
+   uint32_t pos = q->tail;
+   uint32_t index = pos & q->mask;
+
+   if (slot_seq(q, index) != pos + 1U)
+   {
+      return -EAGAIN;
+   }
+
+   memcpy(item, &q->buffer[index * q->item_size], q->item_size);
+
+   // Hand the slot back to the producers for the next lap
+   slot_seq_set(q, index, pos + q->mask + 1U);
+   q->tail = pos + 1U;
+
+   return 0;
+}
+
+// Number of items rejected because the queue was full
+uint32_t mpsc_queue_dropped(struct mpsc_queue *q)
+{
+   return (uint32_t)atomic_get(&q->dropped);
+}
@@ -0,0 +1,164 @@
+#include "msg_history.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#include <errno.h>
+#include <string.h>
+
+// Register module log name
+LOG_MODULE_REGISTER(History, LOG_LEVEL_DBG);
+
+#define MSG_HISTORY_SIZE CONFIG_APP_MSG_HISTORY_SIZE
+
+// Statically allocated arena. Entries are stored in insertion order, so the
+// sequence numbers inside the ring are always contiguous and any of them can
+// be located with a single modulo operation.
+static msg_history_entry_t history[MSG_HISTORY_SIZE];
+static uint16_t oldest_index;
+static uint16_t count;
+static uint32_t next_seq = 1U;
+static struct k_spinlock history_lock;
+
+static uint16_t seq_to_index(uint32_t seq, uint32_t oldest_seq);
+
+// Store a new message, evicting the oldest one when the ring is full.
+// Returns the sequence number assigned to the message.
+uint32_t msg_history_add(const char *msg, uint16_t size, uint32_t timestamp)
+{
+   uint16_t size_str = size >= DISPLAY_MSG_BUFFER_SIZE ? DISPLAY_MSG_BUFFER_SIZE - 1 : size;
+   k_spinlock_key_t key = k_spin_lock(&history_lock);
+   uint16_t index = (oldest_index + count) % MSG_HISTORY_SIZE;
+
+   if (count == MSG_HISTORY_SIZE)
+   {
+      // Ring is full: the slot to be written is the oldest one
+      oldest_index = (oldest_index + 1U) % MSG_HISTORY_SIZE;
+   }
+   else
+   {
+      count++;
+   }
+
+   msg_history_entry_t *entry = &history[index];
+
+   entry->seq = next_seq++;
+   entry->timestamp = timestamp;
+   entry->len = (uint8_t)size_str;
+   memcpy(entry->msg_buffer, msg, size_str);
+   entry->msg_buffer[size_str] = '\0';
+
+   uint32_t seq = entry->seq;
+
+   k_spin_unlock(&history_lock, key);
+
+   LOG_DBG("Stored message #%u (%u bytes)", seq, size_str);
+
+   return seq;
+}
+
+// Copy the entry with the given sequence number.
+// Returns 0 on success or -ENOENT if it was evicted or never existed.
+int msg_history_get(uint32_t seq, msg_history_entry_t *entry)
+{
+   int err = -ENOENT;
+   k_spinlock_key_t key = k_spin_lock(&history_lock);
+
+   if (count > 0U)
+   {
+      uint32_t oldest_seq = history[oldest_index].seq;
+
+      if (seq >= oldest_seq && seq - oldest_seq < count)
+      {
+         *entry = history[seq_to_index(seq, oldest_seq)];
+         err = 0;
+      }
+   }
+
+   k_spin_unlock(&history_lock, key);
+
+   return err;
+}
+
+// Get the sequence range currently held. Both values are 0 when empty.
+// Returns the number of stored messages.
+uint16_t msg_history_range(uint32_t *oldest_seq, uint32_t *newest_seq)
+{
+   k_spinlock_key_t key = k_spin_lock(&history_lock);
+   uint16_t stored = count;
+
+   *oldest_seq = stored ? history[oldest_index].seq : 0U;
+   *newest_seq = stored ? *oldest_seq + stored - 1U : 0U;
+
+   k_spin_unlock(&history_lock, key);
+
+   return stored;
+}
+
+// Page format (little endian):
+//   header: oldest seq (u32) | newest seq (u32) | entries in this page (u8)
+//   entry:  seq (u32) | timestamp (u32) | length (u8) | message (length bytes)
+// Entries start at the first stored sequence number >= start_seq and are
+// added while they fit in the buffer. Entries are never truncated: a buffer
+// of MSG_HISTORY_PAGE_MIN_SIZE bytes always holds the first one in full.
+// Returns the encoded size.
+size_t msg_history_encode_page(uint32_t start_seq, uint8_t *buf, size_t size)
+{
+   if (size < MSG_HISTORY_PAGE_HEADER_SIZE)
+   {
+      return 0;
+   }
+
+   k_spinlock_key_t key = k_spin_lock(&history_lock);
+   uint32_t oldest_seq = count ? history[oldest_index].seq : 0U;
+   uint32_t newest_seq = count ? oldest_seq + count - 1U : 0U;
+   size_t used = MSG_HISTORY_PAGE_HEADER_SIZE;
+   uint8_t entries = 0U;
+
+   if (count > 0U)
+   {
+      uint32_t seq = start_seq < oldest_seq ? oldest_seq : start_seq;
+
+      for (; seq <= newest_seq && entries < UINT8_MAX; seq++)
+      {
+         const msg_history_entry_t *entry = &history[seq_to_index(seq, oldest_seq)];
+
+         if (used + MSG_HISTORY_ENTRY_HEADER_SIZE + entry->len > size)
+         {
+            break;
+         }
+
+         sys_put_le32(entry->seq, &buf[used]);
+         sys_put_le32(entry->timestamp, &buf[used + 4]);
+         buf[used + 8] = entry->len;
+         memcpy(&buf[used + MSG_HISTORY_ENTRY_HEADER_SIZE], entry->msg_buffer, entry->len);
+
+         used += MSG_HISTORY_ENTRY_HEADER_SIZE + entry->len;
+         entries++;
+      }
+   }
+
+   k_spin_unlock(&history_lock, key);
+
+   sys_put_le32(oldest_seq, &buf[0]);
+   sys_put_le32(newest_seq, &buf[4]);
+   buf[8] = entries;
+
+   return used;
+}
+
+// Drop every stored message. Sequence numbers keep increasing.
+void msg_history_clear(void)
+{
+   k_spinlock_key_t key = k_spin_lock(&history_lock);
+
+   oldest_index = 0U;
+   count = 0U;
+
+   k_spin_unlock(&history_lock, key);
+}
+
+static uint16_t seq_to_index(uint32_t seq, uint32_t oldest_seq)
+{
+   return (uint16_t)((oldest_index + (seq - oldest_seq)) % MSG_HISTORY_SIZE);
+}
@@ -0,0 +1,212 @@
+#include "notify_coalesce.h"
+
+#include <zephyr/logging/log.h>
+
+// Register module log name
+LOG_MODULE_REGISTER(Notify, LOG_LEVEL_DBG);
+
+struct conn_lookup
+{
+   uint8_t index;
+   struct bt_conn *conn;
+};
+
+static void notify_work_handler(struct k_work *work);
+static void mark_changed(struct bt_conn *conn, void *data);
+static int64_t interval_left(struct notify_coalesce_conn *slot);
+static void set_last_sent(struct notify_coalesce_conn *slot, int64_t last_sent);
+static void find_conn(struct bt_conn *conn, void *data);
+static void indicate_done(struct bt_conn *conn, struct bt_gatt_indicate_params *params, uint8_t err);
+static bool is_subscribed(struct bt_conn *conn, const struct bt_gatt_attr *attr);
+
+void notify_coalesce_init(struct notify_coalesce *nc, const struct bt_gatt_attr *attr,
+                          notify_coalesce_value_cb_t get_value)
+{
+   nc->attr = attr;
+   nc->get_value = get_value;
+   atomic_clear(&nc->sent);
+   atomic_clear(&nc->suppressed);
+
+   for (uint8_t i = 0U; i < ARRAY_SIZE(nc->conns); i++)
+   {
+      struct notify_coalesce_conn *slot = &nc->conns[i];
+
+      slot->owner = nc;
+      slot->index = i;
+      slot->last_sent = 0;
+      atomic_clear(&slot->pending);
+      atomic_clear(&slot->indicating);
+      k_work_init_delayable(&slot->work, notify_work_handler);
+   }
+}
+
+// Signal that the characteristic value changed. Every subscribed connection
+// gets at most one notification per CONFIG_APP_NOTIFY_INTERVAL_MS, carrying
+// the latest value; changes in between are merged into the pending one.
+void notify_coalesce_changed(struct notify_coalesce *nc)
+{
+   bt_conn_foreach(BT_CONN_TYPE_LE, mark_changed, nc);
+}
+
+// Drop any pending notification for a connection that is going away
+void notify_coalesce_conn_reset(struct notify_coalesce *nc, struct bt_conn *conn)
+{
+   struct notify_coalesce_conn *slot = &nc->conns[bt_conn_index(conn)];
+
+   (void)k_work_cancel_delayable(&slot->work);
+   atomic_clear(&slot->pending);
+   atomic_clear(&slot->indicating);
+   set_last_sent(slot, 0);
+}
+
+uint32_t notify_coalesce_sent(const struct notify_coalesce *nc)
+{
+   return (uint32_t)atomic_get(&nc->sent);
+}
+
+uint32_t notify_coalesce_suppressed(const struct notify_coalesce *nc)
+{
+   return (uint32_t)atomic_get(&nc->suppressed);
+}
+
+static void mark_changed(struct bt_conn *conn, void *data)
+{
+   struct notify_coalesce *nc = data;
+   struct notify_coalesce_conn *slot = &nc->conns[bt_conn_index(conn)];
+
+   if (!is_subscribed(conn, nc->attr))
+   {
+      return;
+   }
+
+   if (atomic_set(&slot->pending, 1))
+   {
+      // Already waiting for the interval: the new value replaces the old one
+      atomic_inc(&nc->suppressed);
+      return;
+   }
+
+   (void)k_work_schedule(&slot->work, K_MSEC(interval_left(slot)));
+}
+
+// Time left before the connection may get its next notification, in ms
+static int64_t interval_left(struct notify_coalesce_conn *slot)
+{
+   k_spinlock_key_t key = k_spin_lock(&slot->lock);
+   int64_t elapsed = k_uptime_get() - slot->last_sent;
+
+   k_spin_unlock(&slot->lock, key);
+
+   return elapsed >= CONFIG_APP_NOTIFY_INTERVAL_MS ? 0 : CONFIG_APP_NOTIFY_INTERVAL_MS - elapsed;
+}
+
+static void set_last_sent(struct notify_coalesce_conn *slot, int64_t last_sent)
+{
+   k_spinlock_key_t key = k_spin_lock(&slot->lock);
+
+   slot->last_sent = last_sent;
+
+   k_spin_unlock(&slot->lock, key);
+}
+
+static void notify_work_handler(struct k_work *work)
+{
+   struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+   struct notify_coalesce_conn *slot = CONTAINER_OF(dwork, struct notify_coalesce_conn, work);
+   struct notify_coalesce *nc = slot->owner;
+   struct conn_lookup lookup = { .index = slot->index, .conn = NULL };
+   int64_t delay;
+   int err = 0;
+
+   bt_conn_foreach(BT_CONN_TYPE_LE, find_conn, &lookup);
+   if (lookup.conn == NULL)
+   {
+      atomic_clear(&slot->pending);
+      return;
+   }
+
+   // The previous indication is not confirmed yet, try again in one interval
+   if (atomic_get(&slot->indicating))
+   {
+      (void)k_work_schedule(&slot->work, K_MSEC(CONFIG_APP_NOTIFY_INTERVAL_MS));
+      bt_conn_unref(lookup.conn);
+      return;
+   }
+
+   // A change marked while the previous notification was being sent may
+   // have scheduled this run early: the interval is enforced here
+   delay = interval_left(slot);
+   if (delay > 0)
+   {
+      (void)k_work_schedule(&slot->work, K_MSEC(delay));
+      bt_conn_unref(lookup.conn);
+      return;
+   }
+
+   atomic_clear(&slot->pending);
+
+   uint16_t mtu_payload = bt_gatt_get_mtu(lookup.conn) - 3U;
+   uint16_t len = nc->get_value(slot->value, MIN(sizeof(slot->value), mtu_payload));
+
+   if (bt_gatt_is_subscribed(lookup.conn, nc->attr, BT_GATT_CCC_NOTIFY))
+   {
+      err = bt_gatt_notify(lookup.conn, nc->attr, slot->value, len);
+   }
+   else if (bt_gatt_is_subscribed(lookup.conn, nc->attr, BT_GATT_CCC_INDICATE))
+   {
+      slot->ind_params.attr = nc->attr;
+      slot->ind_params.func = indicate_done;
+      slot->ind_params.destroy = NULL;
+      slot->ind_params.data = slot->value;
+      slot->ind_params.len = len;
+
+      atomic_set(&slot->indicating, 1);
+      err = bt_gatt_indicate(lookup.conn, &slot->ind_params);
+      if (err)
+      {
+         atomic_clear(&slot->indicating);
+      }
+   }
+   else
+   {
+      // Unsubscribed since the change was marked: nothing was sent, so it
+      // is neither counted nor delays the next notification
+      bt_conn_unref(lookup.conn);
+      return;
+   }
+
+   if (err)
+   {
+      LOG_WRN("Notification failed (err %d)", err);
+   }
+   else
+   {
+      set_last_sent(slot, k_uptime_get());
+      atomic_inc(&nc->sent);
+   }
+
+   bt_conn_unref(lookup.conn);
+}
+
+static void indicate_done(struct bt_conn *conn, struct bt_gatt_indicate_params *params, uint8_t err)
+{
+   struct notify_coalesce_conn *slot = CONTAINER_OF(params, struct notify_coalesce_conn, ind_params);
+
+   atomic_clear(&slot->indicating);
+}
+
+static void find_conn(struct bt_conn *conn, void *data)
+{
+   struct conn_lookup *lookup = data;
+
+   if (lookup->conn == NULL && bt_conn_index(conn) == lookup->index)
+   {
+      lookup->conn = bt_conn_ref(conn);
+   }
+}
+
+static bool is_subscribed(struct bt_conn *conn, const struct bt_gatt_attr *attr)
+{
+   return bt_gatt_is_subscribed(conn, attr, BT_GATT_CCC_NOTIFY) ||
+          bt_gatt_is_subscribed(conn, attr, BT_GATT_CCC_INDICATE);
+}
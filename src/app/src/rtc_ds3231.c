@@ -15,6 +15,9 @@ static struct maxim_ds3231_alarm min_alarm;
 // FIXME
 // Use queue to share this information
 static const char *rtc_msg_time;
+// Last RTC time in seconds since the epoch, used to timestamp messages
+static atomic_t rtc_last_timestamp;
+static rtc_ds3231_tick_cb_t rtc_tick_cb;
 
 
 static const char *format_time(time_t time, long nsec);
@@ -23,7 +26,7 @@ static void show_counter(const struct device *ds3231);
 static void set_aligned_clock(const struct device *ds3231);
 
 
-void rtc_ds3231_init(void)
+void rtc_ds3231_init(rtc_ds3231_tick_cb_t tick_cb)
 {
    const struct device *const ds3231 = DEVICE_DT_GET_ONE(maxim_ds3231);
 
@@ -32,6 +35,8 @@ void rtc_ds3231_init(void)
       return;
    }
 
+   rtc_tick_cb = tick_cb;
+
    uint32_t syncclock_Hz = maxim_ds3231_syncclock_frequency(ds3231);
 
    LOG_DBG("DS3231 on %s syncclock %u Hz\n", CONFIG_BOARD, syncclock_Hz);
@@ -85,6 +90,10 @@ void rtc_ds3231_init(void)
          (uint32_t)sp.rtc.tv_sec, (uint32_t)sp.rtc.tv_nsec,
          sp.syncclock);
 
+   if (rc >= 0) {
+      atomic_set(&rtc_last_timestamp, (atomic_val_t)sp.rtc.tv_sec);
+   }
+
    rc = maxim_ds3231_get_alarm(ds3231, 0, &sec_alarm);
    printk("\nAlarm 1 flags 0x%02X at %u: %d\n", sec_alarm.flags,
          (uint32_t)sec_alarm.time, rc);
@@ -140,6 +149,11 @@ const char* rtc_ds3231_get_last_time(void)
    return rtc_msg_time;
 }
 
+uint32_t rtc_ds3231_get_last_timestamp(void)
+{
+   return (uint32_t)atomic_get(&rtc_last_timestamp);
+}
+
 /* Format times as: YYYY-MM-DD HH:MM:SS DOW DOY */
 static const char *format_time(time_t time,
                long nsec)
@@ -205,11 +219,16 @@ static void min_alarm_handler(const struct device *dev,
       ts->tv_nsec -= NSEC_PER_SEC;
    }
 
+   atomic_set(&rtc_last_timestamp, (atomic_val_t)time);
 	rtc_msg_time = format_time(time, -1);
    printk("%s: adj %d.%09lu, uptime %u:%02u:%02u.%03u, clk err %d ppm\n",
          rtc_msg_time,
          (uint32_t)(ts->tv_sec - time), ts->tv_nsec,
          hr, mn, se, us, err_ppm);
+
+   if (rtc_tick_cb != NULL) {
+      rtc_tick_cb(rtc_msg_time);
+   }
 }
 
 static void show_counter(const struct device *ds3231)
@@ -0,0 +1,441 @@
+#include "ssd1306_marquee.h"
+#include "app_event.h"
+
+#include <zephyr/logging/log.h>
+#include <zephyr/drivers/i2c.h>
+#include <string.h>
+
+// Register module log name
+LOG_MODULE_REGISTER(Marquee, LOG_LEVEL_DBG);
+
+// SSD1306 scroll commands
+#define SSD1306_CONTROL_ALL_BYTES_CMD  0x00
+#define SSD1306_CONTROL_BYTE_CMD       0x80
+#define SSD1306_CONTROL_ALL_BYTES_DATA 0x40
+#define SSD1306_SET_COLUMN_ADDRESS     0x21
+#define SSD1306_SET_PAGE_ADDRESS       0x22
+#define SSD1306_RIGHT_HORIZ_SCROLL     0x26
+#define SSD1306_LEFT_HORIZ_SCROLL      0x27
+#define SSD1306_DEACTIVATE_SCROLL      0x2E
+#define SSD1306_ACTIVATE_SCROLL        0x2F
+
+#define DISPLAY_NODE DT_CHOSEN(zephyr_display)
+
+// With segment remap the panel is mirrored, so moving the RAM content to the
+// lower columns (visually to the left) is a right scroll for the controller.
+#if DT_PROP(DISPLAY_NODE, segment_remap)
+#define MARQUEE_SCROLL_CMD SSD1306_RIGHT_HORIZ_SCROLL
+#else
+#define MARQUEE_SCROLL_CMD SSD1306_LEFT_HORIZ_SCROLL
+#endif
+
+#define MARQUEE_STEP_US \
+   ((uint32_t)CONFIG_APP_MARQUEE_STEP_FRAMES * USEC_PER_SEC / CONFIG_APP_MARQUEE_FRAME_RATE_HZ)
+
+static const struct i2c_dt_spec display_i2c = I2C_DT_SPEC_GET(DISPLAY_NODE);
+static const struct device *marquee_display_dev;
+
+// Off-screen strip with the whole message, in the SSD1306 page layout
+static uint8_t strip[MARQUEE_PAGES][MARQUEE_STRIP_MAX_COLS];
+static uint16_t strip_cols;
+// Strip column shown on the left edge of the window
+static uint16_t strip_offset;
+static uint16_t steps_since_sync;
+static bool marquee_active;
+static bool marquee_paused;
+// Commands to stop the scroll and set the address window, each after its
+// own control byte, then the data control byte and the columns
+#define WINDOW_CMD_SIZE (2 * 7 + 1)
+static uint8_t window[WINDOW_CMD_SIZE + MARQUEE_PAGES * MARQUEE_WIDTH];
+
+// The controller RAM must not be accessed while the scroll runs: the scroll
+// is held for every write and armed again afterwards. A step costs two I2C
+// transfers, one to stop the scroll and write the revealed columns and one
+// to arm it again.
+static bool scroll_running;
+static int64_t scroll_armed_ticks;
+static atomic_t step_due;
+static struct k_timer step_timer;
+static void (*panel_flush_cb)(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p);
+
+static uint8_t scroll_interval_code(uint32_t frames);
+static int ssd1306_send_cmd(const uint8_t *cmd, size_t len);
+static int scroll_activate(void);
+static int scroll_deactivate(void);
+static int scroll_hold(bool full_window);
+static int scroll_rearm(void);
+static void marquee_flush(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p);
+static uint16_t render_strip(const char *text, const lv_font_t *font, bool ink_bit);
+static int write_columns(uint16_t x, uint16_t first_strip_col, uint16_t cols);
+static int marquee_sync(void);
+static void step_timer_expiry(struct k_timer *timer);
+
+int ssd1306_marquee_init(const struct device *display_dev)
+{
+   if (!device_is_ready(display_i2c.bus))
+   {
+      LOG_ERR("Device %s is not ready.", display_i2c.bus->name);
+      return -ENODEV;
+   }
+
+   marquee_display_dev = display_dev;
+   k_timer_init(&step_timer, step_timer_expiry, NULL);
+
+   // LVGL flushes hold the scroll as well
+   lv_disp_drv_t *disp_drv = lv_disp_get_default()->driver;
+
+   panel_flush_cb = disp_drv->flush_cb;
+   disp_drv->flush_cb = marquee_flush;
+
+   LOG_DBG("Marquee step %u us", MARQUEE_STEP_US);
+
+   return 0;
+}
+
+// Render the message once into the off-screen strip and let the controller
+// scroll it. Afterwards only the newly revealed columns are sent.
+int ssd1306_marquee_start(const char *text, const lv_font_t *font, bool ink_bit)
+{
+   if (marquee_display_dev == NULL)
+   {
+      return -ENODEV;
+   }
+
+   ssd1306_marquee_stop();
+
+   strip_cols = render_strip(text, font, ink_bit);
+   strip_offset = 0U;
+   marquee_active = true;
+
+   LOG_DBG("Marquee strip %u columns", strip_cols);
+
+   return marquee_sync();
+}
+
+void ssd1306_marquee_stop(void)
+{
+   if (!marquee_active)
+   {
+      return;
+   }
+
+   k_timer_stop(&step_timer);
+   atomic_clear(&step_due);
+   (void)scroll_deactivate();
+   scroll_running = false;
+   marquee_active = false;
+}
+
+// Hold the scroll while another module writes the controller RAM directly
+void ssd1306_marquee_pause(void)
+{
+   if (marquee_active && !marquee_paused)
+   {
+      (void)scroll_hold(false);
+      marquee_paused = true;
+   }
+}
+
+void ssd1306_marquee_resume(void)
+{
+   if (!marquee_paused)
+   {
+      return;
+   }
+
+   marquee_paused = false;
+
+   if (marquee_active)
+   {
+      (void)scroll_rearm();
+   }
+}
+
+bool ssd1306_marquee_is_active(void)
+{
+   return marquee_active;
+}
+
+// Must run in the context that drives the display, since it shares the
+// controller address window with the display driver.
+void ssd1306_marquee_process(void)
+{
+   if (!marquee_active || marquee_paused || atomic_clear(&step_due) == 0)
+   {
+      return;
+   }
+
+   if (scroll_hold(false) < 0)
+   {
+      return;
+   }
+
+   (void)scroll_rearm();
+}
+
+static int marquee_sync(void)
+{
+   int err;
+
+   if (scroll_running)
+   {
+      err = scroll_hold(true);
+   }
+   else
+   {
+      steps_since_sync = 0U;
+      err = write_columns(0U, strip_offset, MARQUEE_WIDTH);
+   }
+
+   if (err < 0)
+   {
+      return err;
+   }
+
+   return marquee_paused ? 0 : scroll_rearm();
+}
+
+// Stop the scroll before an access to the controller RAM and write the
+// columns revealed on the right edge since it was armed, in the same transfer
+static int scroll_hold(bool full_window)
+{
+   int err;
+
+   if (!scroll_running)
+   {
+      return 0;
+   }
+
+   k_timer_stop(&step_timer);
+   atomic_clear(&step_due);
+   scroll_running = false;
+
+   uint32_t elapsed_us = k_ticks_to_us_floor32(k_uptime_ticks() - scroll_armed_ticks);
+   uint16_t steps = (uint16_t)MIN(elapsed_us / MARQUEE_STEP_US, MARQUEE_WIDTH);
+
+   strip_offset = (strip_offset + steps) % strip_cols;
+   steps_since_sync += steps;
+
+   // The controller frame clock is not exact: rewrite the whole window from
+   // time to time to remove any drift between the timer and the scroll.
+   if (full_window || steps_since_sync >= CONFIG_APP_MARQUEE_RESYNC_STEPS)
+   {
+      steps_since_sync = 0U;
+      err = write_columns(0U, strip_offset, MARQUEE_WIDTH);
+   }
+   else if (steps > 0U)
+   {
+      err = write_columns(MARQUEE_WIDTH - steps,
+                          (strip_offset + MARQUEE_WIDTH - steps) % strip_cols,
+                          steps);
+   }
+   else
+   {
+      err = scroll_deactivate();
+   }
+
+   if (err < 0)
+   {
+      LOG_ERR("Scroll hold failed (err %d)", err);
+   }
+
+   return err;
+}
+
+static int scroll_rearm(void)
+{
+   int err = scroll_activate();
+
+   if (err < 0)
+   {
+      LOG_ERR("Scroll activate failed (err %d)", err);
+      return err;
+   }
+
+   scroll_armed_ticks = k_uptime_ticks();
+   scroll_running = true;
+
+   // Hold the scroll half a step after the controller moved the window
+   k_timer_start(&step_timer, K_USEC(MARQUEE_STEP_US + MARQUEE_STEP_US / 2U), K_NO_WAIT);
+
+   return 0;
+}
+
+static void step_timer_expiry(struct k_timer *timer)
+{
+   atomic_set(&step_due, 1);
+   app_event_post(APP_EVENT_DISPLAY);
+}
+
+// LVGL flushes write the controller RAM too
+static void marquee_flush(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p)
+{
+   bool running = scroll_running;
+
+   if (running)
+   {
+      (void)scroll_hold(false);
+   }
+
+   panel_flush_cb(drv, area, color_p);
+
+   if (running && marquee_active && !marquee_paused)
+   {
+      (void)scroll_rearm();
+   }
+}
+
+// Stop the scroll and copy cols strip columns, starting at first_strip_col,
+// to the screen at x in one I2C transfer. The driver leaves the controller
+// in horizontal addressing mode, so the columns of both pages follow each
+// other in the address window.
+static int write_columns(uint16_t x, uint16_t first_strip_col, uint16_t cols)
+{
+   const uint8_t cmds[] = {
+      SSD1306_DEACTIVATE_SCROLL,
+      SSD1306_SET_COLUMN_ADDRESS, (uint8_t)x, (uint8_t)(x + cols - 1U),
+      SSD1306_SET_PAGE_ADDRESS, MARQUEE_FIRST_PAGE, MARQUEE_FIRST_PAGE + MARQUEE_PAGES - 1,
+   };
+   uint8_t *data = &window[WINDOW_CMD_SIZE];
+
+   BUILD_ASSERT(WINDOW_CMD_SIZE == 2 * sizeof(cmds) + 1, "Wrong command size");
+
+   for (size_t i = 0U; i < sizeof(cmds); i++)
+   {
+      window[2U * i] = SSD1306_CONTROL_BYTE_CMD;
+      window[2U * i + 1U] = cmds[i];
+   }
+
+   window[WINDOW_CMD_SIZE - 1] = SSD1306_CONTROL_ALL_BYTES_DATA;
+
+   for (uint8_t page = 0U; page < MARQUEE_PAGES; page++)
+   {
+      for (uint16_t col = 0U; col < cols; col++)
+      {
+         data[page * cols + col] = strip[page][(first_strip_col + col) % strip_cols];
+      }
+   }
+
+   return i2c_write_dt(&display_i2c, window, WINDOW_CMD_SIZE + MARQUEE_PAGES * cols);
+}
+
+// Rasterize the text with the LVGL font into the strip, followed by a blank
+// gap so the end of the message is not glued to its start.
+static uint16_t render_strip(const char *text, const lv_font_t *font, bool ink_bit)
+{
+   const uint8_t background = ink_bit ? 0x00 : 0xFF;
+   const int16_t base_y = (int16_t)(font->line_height - font->base_line);
+   int32_t pen_x = 0;
+   uint32_t i = 0;
+
+   memset(strip, background, sizeof(strip));
+
+   while (text[i] != '\0')
+   {
+      lv_font_glyph_dsc_t dsc;
+      uint32_t letter = _lv_txt_encoded_next(text, &i);
+      uint32_t next_i = i;
+      uint32_t letter_next = _lv_txt_encoded_next(text, &next_i);
+
+      if (!lv_font_get_glyph_dsc(font, &dsc, letter, letter_next))
+      {
+         continue;
+      }
+
+      if (pen_x + dsc.adv_w + CONFIG_APP_MARQUEE_GAP_COLS > MARQUEE_STRIP_MAX_COLS)
+      {
+         LOG_WRN("Message truncated in the marquee");
+         break;
+      }
+
+      const uint8_t *bitmap = lv_font_get_glyph_bitmap(font, letter);
+      uint32_t bit = 0U;
+      const uint8_t mask = (uint8_t)((1U << dsc.bpp) - 1U);
+      const uint8_t threshold = (uint8_t)(1U << (dsc.bpp - 1U));
+      int16_t glyph_y = base_y - dsc.box_h - dsc.ofs_y;
+
+      // Glyph bitmaps are a continuous stream of bpp wide pixels
+      for (uint16_t row = 0U; bitmap != NULL && row < dsc.box_h; row++)
+      {
+         for (uint16_t col = 0U; col < dsc.box_w; col++, bit += dsc.bpp)
+         {
+            uint8_t value = (bitmap[bit / 8U] >> (8U - dsc.bpp - (bit % 8U))) & mask;
+            int32_t x = pen_x + dsc.ofs_x + col;
+            int32_t y = glyph_y + row;
+
+            if (value < threshold || x < 0 || x >= MARQUEE_STRIP_MAX_COLS ||
+                y < 0 || y >= MARQUEE_HEIGHT)
+            {
+               continue;
+            }
+
+            WRITE_BIT(strip[y / 8][x], y % 8, ink_bit);
+         }
+      }
+
+      pen_x += dsc.adv_w;
+   }
+
+   return (uint16_t)MAX(pen_x + CONFIG_APP_MARQUEE_GAP_COLS, MARQUEE_WIDTH);
+}
+
+static uint8_t scroll_interval_code(uint32_t frames)
+{
+   switch (frames)
+   {
+   case 2:
+      return 0x07;
+   case 3:
+      return 0x04;
+   case 4:
+      return 0x05;
+   case 25:
+      return 0x06;
+   case 64:
+      return 0x01;
+   case 128:
+      return 0x02;
+   case 256:
+      return 0x03;
+   default:
+      return 0x00; // 5 frames
+   }
+}
+
+static int scroll_activate(void)
+{
+   const uint8_t setup[] = {
+      MARQUEE_SCROLL_CMD,
+      0x00,
+      MARQUEE_FIRST_PAGE,
+      scroll_interval_code(CONFIG_APP_MARQUEE_STEP_FRAMES),
+      MARQUEE_FIRST_PAGE + MARQUEE_PAGES - 1,
+      0x00,
+      0xFF,
+      SSD1306_ACTIVATE_SCROLL,
+   };
+
+   return ssd1306_send_cmd(setup, sizeof(setup));
+}
+
+static int scroll_deactivate(void)
+{
+   const uint8_t cmd = SSD1306_DEACTIVATE_SCROLL;
+
+   return ssd1306_send_cmd(&cmd, sizeof(cmd));
+}
+
+static int ssd1306_send_cmd(const uint8_t *cmd, size_t len)
+{
+   uint8_t buf[1 + 8];
+
+   if (len > sizeof(buf) - 1U)
+   {
+      return -EINVAL;
+   }
+
+   buf[0] = SSD1306_CONTROL_ALL_BYTES_CMD;
+   memcpy(&buf[1], cmd, len);
+
+   return i2c_write_dt(&display_i2c, buf, len + 1U);
+}
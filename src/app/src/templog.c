@@ -0,0 +1,326 @@
+#include "templog.h"
+#include "templog_ring.h"
+#include "rtc_ds3231.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/byteorder.h>
+#if defined(CONFIG_APP_TEMPLOG_FLASH)
+#include <zephyr/fs/fcb.h>
+#endif
+#include <string.h>
+
+// Register module log name
+LOG_MODULE_REGISTER(TempLog, LOG_LEVEL_DBG);
+
+#define TEMPLOG_BLOCK_SIZE    CONFIG_APP_TEMPLOG_BLOCK_SIZE
+#define TEMPLOG_PERIOD_S      CONFIG_APP_TEMPLOG_PERIOD_S
+
+// DS3231 temperature registers: integer part (i8) then fraction in bits 7:6
+#define DS3231_REG_TEMP_MSB   0x11
+
+BUILD_ASSERT((TEMPLOG_BLOCK_SIZE % 8) == 0, "Block size must be a multiple of the flash write size");
+
+static const struct i2c_dt_spec ds3231_i2c = I2C_DT_SPEC_GET(DT_NODELABEL(ds3231));
+
+// RAM ring of blocks, the oldest one is spilled to flash when it leaves
+static struct templog_ring ring;
+
+// Stream offsets: oldest byte still available and end of the stream
+static uint32_t stream_start;
+static uint32_t stream_end;
+
+static struct k_work_delayable sample_work;
+
+#if defined(CONFIG_APP_TEMPLOG_FLASH)
+#define TEMPLOG_FCB_MAGIC     0x474f4c54   // "TLOG"
+
+static struct fcb templog_fcb;
+static struct flash_sector templog_sectors[CONFIG_APP_TEMPLOG_FLASH_SECTORS];
+static bool flash_ready;
+// Last flash entry found by templog_read(), reads are mostly sequential
+static struct fcb_entry flash_cursor;
+static uint32_t flash_cursor_offset;
+static bool flash_cursor_valid;
+
+static int flash_init(void);
+static void flash_spill(const uint8_t *buf, uint16_t len);
+static int flash_read(uint32_t offset, uint8_t *buf, uint16_t len, uint32_t *read_offset);
+static uint32_t flash_first_offset(void);
+#endif
+
+static int read_temperature(int16_t *temp_q);
+static void sample_work_handler(struct k_work *work);
+
+int templog_init(void)
+{
+   if (!device_is_ready(ds3231_i2c.bus))
+   {
+      LOG_ERR("Device %s is not ready.", ds3231_i2c.bus->name);
+      return -ENODEV;
+   }
+
+#if defined(CONFIG_APP_TEMPLOG_FLASH)
+   if (flash_init() < 0)
+   {
+      LOG_WRN("Temperature log kept in RAM only");
+   }
+#endif
+
+   // Continue the stream after the blocks stored before the reset
+   templog_ring_init(&ring, stream_end);
+
+   k_work_init_delayable(&sample_work, sample_work_handler);
+   k_work_schedule(&sample_work, K_NO_WAIT);
+
+   LOG_INF("Temperature log from offset %u to %u", stream_start, stream_end);
+
+   return 0;
+}
+
+void templog_get_range(uint32_t *start_offset, uint32_t *end_offset)
+{
+   *start_offset = stream_start;
+   *end_offset = stream_end;
+}
+
+// Copy up to len bytes of the stream, starting at offset or at the next
+// byte still available if offset was dropped or never reached the flash.
+// read_offset gets the offset of the first copied byte. Returns the number
+// of bytes copied, 0 only at the end of the stream, or -ENODATA when
+// nothing is left to read before the end.
+// Must run in the system work queue, where the log is written.
+int templog_read(uint32_t offset, uint8_t *buf, uint16_t len, uint32_t *read_offset)
+{
+   offset = MAX(offset, stream_start);
+
+   if (offset >= stream_end)
+   {
+      return 0;
+   }
+
+   uint16_t size = templog_ring_read(&ring, offset, buf, len);
+
+   if (size > 0U)
+   {
+      *read_offset = offset;
+      return size;
+   }
+
+#if defined(CONFIG_APP_TEMPLOG_FLASH)
+   int rc = flash_read(offset, buf, len, read_offset);
+
+   if (rc != 0)
+   {
+      return rc;
+   }
+#endif
+
+   // Past the last block in flash, e.g. after a failed spill or an erased
+   // sector: continue at the oldest block in RAM
+   uint32_t ring_start = templog_ring_start(&ring);
+
+   if (offset < ring_start)
+   {
+      size = templog_ring_read(&ring, ring_start, buf, len);
+
+      if (size > 0U)
+      {
+         *read_offset = ring_start;
+         return size;
+      }
+   }
+
+   LOG_ERR("Temperature log offset %u not available", offset);
+
+   return -ENODATA;
+}
+
+static void sample_work_handler(struct k_work *work)
+{
+   int16_t temp_q;
+
+   k_work_schedule(&sample_work, K_SECONDS(TEMPLOG_PERIOD_S));
+
+   if (read_temperature(&temp_q) < 0)
+   {
+      // A gap starts a new block
+      templog_ring_close(&ring);
+      return;
+   }
+
+#if defined(CONFIG_APP_TEMPLOG_FLASH)
+   if (templog_ring_append(&ring, temp_q, rtc_ds3231_get_last_timestamp(), flash_spill))
+   {
+      stream_start = flash_ready ? flash_first_offset() : templog_ring_start(&ring);
+   }
+#else
+   if (templog_ring_append(&ring, temp_q, rtc_ds3231_get_last_timestamp(), NULL))
+   {
+      stream_start = templog_ring_start(&ring);
+   }
+#endif
+
+   stream_end = ring.end;
+}
+
+static int read_temperature(int16_t *temp_q)
+{
+   uint8_t reg = DS3231_REG_TEMP_MSB;
+   uint8_t data[2];
+   int err = i2c_write_read_dt(&ds3231_i2c, &reg, sizeof(reg), data, sizeof(data));
+
+   if (err < 0)
+   {
+      LOG_ERR("Temperature read failed (err %d)", err);
+      return err;
+   }
+
+   *temp_q = (int16_t)((int8_t)data[0] * 4 + (data[1] >> 6));
+
+   return 0;
+}
+
+#if defined(CONFIG_APP_TEMPLOG_FLASH)
+static int flash_init(void)
+{
+   struct fcb_entry loc = { 0 };
+   uint8_t header[TEMPLOG_BLOCK_HEADER_SIZE];
+   uint32_t sector_cnt = ARRAY_SIZE(templog_sectors);
+   int err = flash_area_get_sectors(FIXED_PARTITION_ID(templog_partition), &sector_cnt, templog_sectors);
+
+   if (err < 0)
+   {
+      LOG_ERR("Temperature log partition not found (err %d)", err);
+      return err;
+   }
+
+   templog_fcb.f_magic = TEMPLOG_FCB_MAGIC;
+   templog_fcb.f_sectors = templog_sectors;
+   templog_fcb.f_sector_cnt = (uint8_t)sector_cnt;
+
+   err = fcb_init(FIXED_PARTITION_ID(templog_partition), &templog_fcb);
+   if (err < 0)
+   {
+      LOG_ERR("Temperature log flash init failed (err %d)", err);
+      return err;
+   }
+
+   flash_ready = true;
+
+   // Continue the stream after the blocks stored before the reset
+   while (fcb_getnext(&templog_fcb, &loc) == 0)
+   {
+      if (flash_area_read(templog_fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc), header, sizeof(header)) == 0)
+      {
+         stream_end = templog_block_offset(header) + loc.fe_data_len;
+      }
+   }
+
+   stream_start = flash_first_offset();
+
+   return 0;
+}
+
+static void flash_spill(const uint8_t *buf, uint16_t len)
+{
+   struct fcb_entry loc;
+   int err;
+
+   if (!flash_ready)
+   {
+      return;
+   }
+
+   err = fcb_append(&templog_fcb, len, &loc);
+   if (err == -ENOSPC)
+   {
+      // Drop the oldest sector
+      flash_cursor_valid = false;
+      (void)fcb_rotate(&templog_fcb);
+      err = fcb_append(&templog_fcb, len, &loc);
+   }
+
+   if (err < 0)
+   {
+      LOG_ERR("Temperature log append failed (err %d)", err);
+      return;
+   }
+
+   // The entry is reserved aligned to the write size, so is the block buffer
+   err = flash_area_write(templog_fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc), buf,
+                          ROUND_UP(len, templog_fcb.f_align));
+   if (err == 0)
+   {
+      err = fcb_append_finish(&templog_fcb, &loc);
+   }
+
+   if (err < 0)
+   {
+      LOG_ERR("Temperature log write failed (err %d)", err);
+   }
+}
+
+static uint32_t flash_first_offset(void)
+{
+   struct fcb_entry loc = { 0 };
+   uint8_t header[TEMPLOG_BLOCK_HEADER_SIZE];
+
+   if (fcb_getnext(&templog_fcb, &loc) == 0 &&
+       flash_area_read(templog_fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc), header, sizeof(header)) == 0)
+   {
+      return templog_block_offset(header);
+   }
+
+   // Nothing in flash yet, the stream starts in RAM
+   return ring.count ? templog_ring_start(&ring) : stream_end;
+}
+
+static int flash_read(uint32_t offset, uint8_t *buf, uint16_t len, uint32_t *read_offset)
+{
+   uint8_t header[TEMPLOG_BLOCK_HEADER_SIZE];
+
+   if (!flash_ready)
+   {
+      return 0;
+   }
+
+   if (!flash_cursor_valid || offset < flash_cursor_offset)
+   {
+      memset(&flash_cursor, 0, sizeof(flash_cursor));
+      flash_cursor_valid = false;
+   }
+
+   while (!flash_cursor_valid || offset >= flash_cursor_offset + flash_cursor.fe_data_len)
+   {
+      if (fcb_getnext(&templog_fcb, &flash_cursor) != 0 ||
+          flash_area_read(templog_fcb.fap, FCB_ENTRY_FA_DATA_OFF(flash_cursor), header, sizeof(header)) != 0)
+      {
+         flash_cursor_valid = false;
+         return 0;
+      }
+
+      flash_cursor_offset = templog_block_offset(header);
+      flash_cursor_valid = true;
+
+      // offset was dropped with a rotated sector, continue at this block
+      offset = MAX(offset, flash_cursor_offset);
+   }
+
+   uint16_t size = MIN(len, flash_cursor_offset + flash_cursor.fe_data_len - offset);
+   int err = flash_area_read(templog_fcb.fap,
+                             FCB_ENTRY_FA_DATA_OFF(flash_cursor) + (offset - flash_cursor_offset),
+                             buf, size);
+
+   if (err < 0)
+   {
+      return err;
+   }
+
+   *read_offset = offset;
+
+   return size;
+}
+#endif
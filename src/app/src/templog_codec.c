@@ -0,0 +1,121 @@
+#include "templog_codec.h"
+
+#include <zephyr/sys/byteorder.h>
+#include <errno.h>
+#include <stddef.h>
+
+// Start a new block in buf with its first sample
+void templog_block_start(templog_block_t *block, uint8_t *buf, uint16_t size, uint32_t offset,
+                         uint32_t timestamp, uint16_t period_s, int16_t temp_q)
+{
+   block->buf = buf;
+   block->size = size;
+   block->last = temp_q;
+
+   buf[0] = TEMPLOG_CODE_BLOCK;
+   sys_put_le32(offset, &buf[1]);
+   sys_put_le32(timestamp, &buf[5]);
+   sys_put_le16(period_s, &buf[9]);
+   sys_put_le16((uint16_t)temp_q, &buf[11]);
+
+   block->used = TEMPLOG_BLOCK_HEADER_SIZE;
+}
+
+// Append the next sample.
+// Returns 0 on success or -ENOSPC when the block is full.
+int templog_block_append(templog_block_t *block, int16_t temp_q)
+{
+   int32_t delta = (int32_t)temp_q - block->last;
+
+   if (delta >= TEMPLOG_DELTA_MIN && delta <= TEMPLOG_DELTA_MAX)
+   {
+      if (block->used + 1U > block->size)
+      {
+         return -ENOSPC;
+      }
+
+      block->buf[block->used++] = (uint8_t)(int8_t)delta;
+   }
+   else
+   {
+      if (block->used + 3U > block->size)
+      {
+         return -ENOSPC;
+      }
+
+      block->buf[block->used] = TEMPLOG_CODE_ABS;
+      sys_put_le16((uint16_t)temp_q, &block->buf[block->used + 1U]);
+      block->used += 3U;
+   }
+
+   block->last = temp_q;
+
+   return 0;
+}
+
+// Stream offset of the block starting at buf
+uint32_t templog_block_offset(const uint8_t *buf)
+{
+   return sys_get_le32(&buf[1]);
+}
+
+// Decode a stream made of whole blocks, calling cb for each sample.
+// Returns the number of samples or -EINVAL if the stream is malformed.
+int templog_decode(const uint8_t *buf, size_t len, templog_sample_cb_t cb, void *user_data)
+{
+   size_t pos = 0;
+   int samples = 0;
+   bool in_block = false;
+   uint32_t timestamp = 0;
+   uint16_t period_s = 0;
+   int16_t temp_q = 0;
+
+   while (pos < len)
+   {
+      uint8_t code = buf[pos];
+
+      if (code == TEMPLOG_CODE_BLOCK)
+      {
+         if (pos + TEMPLOG_BLOCK_HEADER_SIZE > len)
+         {
+            return -EINVAL;
+         }
+
+         timestamp = sys_get_le32(&buf[pos + 5U]);
+         period_s = sys_get_le16(&buf[pos + 9U]);
+         temp_q = (int16_t)sys_get_le16(&buf[pos + 11U]);
+         pos += TEMPLOG_BLOCK_HEADER_SIZE;
+         in_block = true;
+      }
+      else if (!in_block)
+      {
+         return -EINVAL;
+      }
+      else if (code == TEMPLOG_CODE_ABS)
+      {
+         if (pos + 3U > len)
+         {
+            return -EINVAL;
+         }
+
+         timestamp += period_s;
+         temp_q = (int16_t)sys_get_le16(&buf[pos + 1U]);
+         pos += 3U;
+      }
+      else
+      {
+         timestamp += period_s;
+         temp_q = (int16_t)(temp_q + (int8_t)code);
+         pos++;
+      }
+
+      if (cb != NULL)
+      {
+         cb(timestamp, temp_q, user_data);
+      }
+
+      samples++;
+   }
+
+   return samples;
+}
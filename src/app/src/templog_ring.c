@@ -0,0 +1,81 @@
+#include "templog_ring.h"
+
+#include <zephyr/sys/util.h>
+#include <string.h>
+
+void templog_ring_init(struct templog_ring *ring, uint32_t end_offset)
+{
+   memset(ring, 0, sizeof(*ring));
+   ring->end = end_offset;
+}
+
+// Add a sample to the open block, or to a new block when there is none or
+// it is full. Returns true when the oldest block left the ring.
+bool templog_ring_append(struct templog_ring *ring, int16_t temp_q, uint32_t timestamp,
+                         templog_spill_cb_t spill)
+{
+   bool dropped = false;
+   uint8_t index = (ring->oldest + ring->count - 1U) % TEMPLOG_RING_BLOCKS;
+
+   if (!ring->open || templog_block_append(&ring->current, temp_q) < 0)
+   {
+      if (ring->count == TEMPLOG_RING_BLOCKS)
+      {
+         if (spill != NULL)
+         {
+            spill(ring->blocks[ring->oldest], ring->used[ring->oldest]);
+         }
+
+         ring->oldest = (ring->oldest + 1U) % TEMPLOG_RING_BLOCKS;
+         ring->count--;
+         dropped = true;
+      }
+
+      index = (ring->oldest + ring->count) % TEMPLOG_RING_BLOCKS;
+      ring->count++;
+      templog_block_start(&ring->current, ring->blocks[index], TEMPLOG_RING_BLOCK_SIZE,
+                          ring->end, timestamp, CONFIG_APP_TEMPLOG_PERIOD_S, temp_q);
+      ring->open = true;
+   }
+
+   ring->used[index] = ring->current.used;
+   ring->end = templog_block_offset(ring->blocks[index]) + ring->current.used;
+
+   return dropped;
+}
+
+// End the open block. The sample times are implied by the period, so a gap
+// in the samples starts a new block.
+void templog_ring_close(struct templog_ring *ring)
+{
+   ring->open = false;
+}
+
+// Stream offset of the oldest byte in RAM, the end offset when empty
+uint32_t templog_ring_start(const struct templog_ring *ring)
+{
+   return ring->count ? templog_block_offset(ring->blocks[ring->oldest]) : ring->end;
+}
+
+// Copy up to len bytes of the block holding offset.
+// Returns the number of bytes copied, 0 if offset is not in RAM.
+uint16_t templog_ring_read(const struct templog_ring *ring, uint32_t offset, uint8_t *buf,
+                           uint16_t len)
+{
+   for (uint8_t i = 0U; i < ring->count; i++)
+   {
+      uint8_t index = (ring->oldest + i) % TEMPLOG_RING_BLOCKS;
+      uint32_t block_offset = templog_block_offset(ring->blocks[index]);
+
+      if (offset >= block_offset && offset < block_offset + ring->used[index])
+      {
+         uint16_t size = MIN(len, block_offset + ring->used[index] - offset);
+
+         memcpy(buf, &ring->blocks[index][offset - block_offset], size);
+
+         return size;
+      }
+   }
+
+   return 0;
+}
@@ -0,0 +1,211 @@
+#include "time_sync.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/drivers/rtc/maxim_ds3231.h>
+
+// Register module log name
+LOG_MODULE_REGISTER(TimeSync, LOG_LEVEL_DBG);
+
+static const struct device *const ds3231 = DEVICE_DT_GET_ONE(maxim_ds3231);
+
+static struct sys_notify set_notify;
+static struct maxim_ds3231_syncpoint requested;
+static time_sync_result_t last_result;
+static struct k_spinlock result_lock;
+static atomic_t sync_busy;
+static time_sync_done_cb_t sync_done_cb;
+static struct sys_notify refresh_notify;
+static struct k_work_delayable refresh_work;
+
+static int64_t time_at_syncclock(const struct maxim_ds3231_syncpoint *sp, uint32_t syncclock, uint32_t syncclock_Hz);
+static void set_result(const time_sync_result_t *result);
+static void set_done(const struct device *dev, struct sys_notify *notify, int res);
+static void refresh_work_handler(struct k_work *work);
+static void refresh_done(const struct device *dev, struct sys_notify *notify, int res);
+
+void time_sync_init(time_sync_done_cb_t done_cb)
+{
+   sync_done_cb = done_cb;
+
+   k_work_init_delayable(&refresh_work, refresh_work_handler);
+   (void)k_work_schedule(&refresh_work, K_MINUTES(CONFIG_APP_TIME_SYNC_REFRESH_MIN));
+}
+
+// Local clock used to timestamp a request, the same one the RTC sync points use
+uint32_t time_sync_capture(void)
+{
+   return maxim_ds3231_read_syncclock(ds3231);
+}
+
+// Set the RTC from the phone time.
+// The phone time refers to the start of the connection event that carried
+// the request, syncclock is the local clock captured when the request was
+// received and link_delay_us the estimated time between both. The RTC is
+// written at the next second boundary; completion is reported through the
+// callback given to time_sync_init().
+int time_sync_request(uint32_t sec, uint32_t usec, uint32_t syncclock, uint32_t link_delay_us)
+{
+   struct maxim_ds3231_syncpoint current;
+   time_sync_result_t result = { .status = TIME_SYNC_IN_PROGRESS };
+
+   if (!device_is_ready(ds3231))
+   {
+      return -ENODEV;
+   }
+
+   if (atomic_set(&sync_busy, 1))
+   {
+      return -EBUSY;
+   }
+
+   uint32_t syncclock_Hz = maxim_ds3231_syncclock_frequency(ds3231);
+   int64_t phone_ns = (int64_t)sec * NSEC_PER_SEC + (int64_t)usec * NSEC_PER_USEC
+                    + (int64_t)link_delay_us * NSEC_PER_USEC;
+
+   requested.rtc.tv_sec = (time_t)(phone_ns / NSEC_PER_SEC);
+   requested.rtc.tv_nsec = (long)(phone_ns % NSEC_PER_SEC);
+   requested.syncclock = syncclock;
+
+   // Nominal bound: the request timestamp can't be better than one syncclock tick
+   result.uncertainty_us = (uint16_t)MIN(CONFIG_APP_TIME_SYNC_RX_JITTER_US
+                                         + DIV_ROUND_UP(USEC_PER_SEC, syncclock_Hz), UINT16_MAX);
+
+   if (maxim_ds3231_get_syncpoint(ds3231, &current) == 0)
+   {
+      result.correction_ms = (phone_ns - time_at_syncclock(&current, syncclock, syncclock_Hz))
+                             / NSEC_PER_MSEC;
+   }
+
+   set_result(&result);
+
+   sys_notify_init_callback(&set_notify, (sys_notify_generic_callback)set_done);
+
+   int rc = maxim_ds3231_set(ds3231, &requested, &set_notify);
+
+   if (rc < 0)
+   {
+      LOG_ERR("RTC set failed: %d", rc);
+      result.status = TIME_SYNC_FAILED;
+      set_result(&result);
+      atomic_clear(&sync_busy);
+      return rc;
+   }
+
+   LOG_DBG("Time sync to %u.%06u, correction %lld ms", (uint32_t)requested.rtc.tv_sec,
+           (uint32_t)(requested.rtc.tv_nsec / NSEC_PER_USEC), (long long)result.correction_ms);
+
+   return 0;
+}
+
+void time_sync_get_result(time_sync_result_t *result)
+{
+   k_spinlock_key_t key = k_spin_lock(&result_lock);
+
+   *result = last_result;
+
+   k_spin_unlock(&result_lock, key);
+}
+
+// Encode the last result (little endian), see TIME_SYNC_RESULT_SIZE
+uint16_t time_sync_encode_result(uint8_t *buf, uint16_t size)
+{
+   time_sync_result_t result;
+
+   if (size < TIME_SYNC_RESULT_SIZE)
+   {
+      return 0;
+   }
+
+   time_sync_get_result(&result);
+
+   buf[0] = result.status;
+   sys_put_le64((uint64_t)result.correction_ms, &buf[1]);
+   sys_put_le32((uint32_t)result.residual_us, &buf[9]);
+   sys_put_le16(result.uncertainty_us, &buf[13]);
+
+   return TIME_SYNC_RESULT_SIZE;
+}
+
+// RTC time, in ns, at the given syncclock according to a synchronization point
+static int64_t time_at_syncclock(const struct maxim_ds3231_syncpoint *sp, uint32_t syncclock, uint32_t syncclock_Hz)
+{
+   // The syncclock wraps; the difference is valid for half a wrap period,
+   // about 18 hours at 32768 Hz. The syncpoint is refreshed well before.
+   int32_t ticks = (int32_t)(syncclock - sp->syncclock);
+
+   return (int64_t)sp->rtc.tv_sec * NSEC_PER_SEC + sp->rtc.tv_nsec
+          + (int64_t)ticks * NSEC_PER_SEC / syncclock_Hz;
+}
+
+// Take a new synchronization point from time to time, so the syncclock
+// never drifts half a wrap period away from it
+static void refresh_work_handler(struct k_work *work)
+{
+   (void)k_work_schedule(&refresh_work, K_MINUTES(CONFIG_APP_TIME_SYNC_REFRESH_MIN));
+
+   if (!device_is_ready(ds3231) || atomic_set(&sync_busy, 1))
+   {
+      // A sync from the phone writes a new synchronization point anyway
+      return;
+   }
+
+   sys_notify_init_callback(&refresh_notify, (sys_notify_generic_callback)refresh_done);
+
+   int rc = maxim_ds3231_synchronize(ds3231, &refresh_notify);
+
+   if (rc < 0)
+   {
+      LOG_ERR("Syncpoint refresh failed: %d", rc);
+      atomic_clear(&sync_busy);
+   }
+}
+
+static void refresh_done(const struct device *dev, struct sys_notify *notify, int res)
+{
+   atomic_clear(&sync_busy);
+
+   LOG_DBG("Syncpoint refreshed: %d", res);
+}
+
+static void set_result(const time_sync_result_t *result)
+{
+   k_spinlock_key_t key = k_spin_lock(&result_lock);
+
+   last_result = *result;
+
+   k_spin_unlock(&result_lock, key);
+}
+
+// Called by the DS3231 driver when the new time was written
+static void set_done(const struct device *dev, struct sys_notify *notify, int res)
+{
+   struct maxim_ds3231_syncpoint sp;
+   time_sync_result_t result;
+
+   time_sync_get_result(&result);
+   result.status = TIME_SYNC_FAILED;
+
+   if (res >= 0 && maxim_ds3231_get_syncpoint(dev, &sp) == 0)
+   {
+      uint32_t syncclock_Hz = maxim_ds3231_syncclock_frequency(dev);
+      int64_t written_ns = (int64_t)sp.rtc.tv_sec * NSEC_PER_SEC + sp.rtc.tv_nsec;
+
+      result.residual_us = (int32_t)((written_ns - time_at_syncclock(&requested, sp.syncclock, syncclock_Hz))
+                                     / NSEC_PER_USEC);
+      result.status = TIME_SYNC_DONE;
+   }
+
+   set_result(&result);
+   atomic_clear(&sync_busy);
+
+   LOG_INF("Time sync %s: residual %d us, uncertainty %u us",
+           result.status == TIME_SYNC_DONE ? "done" : "failed",
+           result.residual_us, result.uncertainty_us);
+
+   if (sync_done_cb != NULL)
+   {
+      sync_done_cb();
+   }
+}
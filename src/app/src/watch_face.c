@@ -0,0 +1,393 @@
+#include "watch_face.h"
+
+#include "app_event.h"
+#include "face_cache.h"
+
+#include <zephyr/logging/log.h>
+#include <zephyr/drivers/display.h>
+#include <zephyr/sys/atomic.h>
+#include <errno.h>
+#include <string.h>
+
+// Register module log name
+LOG_MODULE_REGISTER(FACE, LOG_LEVEL_DBG);
+
+#define FACE_REQUEST_NONE     (-1)
+#define MSG_LIST_Y            14
+
+#define WATCH_FACE_LAYOUT(face_name, layout)                            \
+   {                                                                    \
+      .name = face_name, .items = layout, .item_count = ARRAY_SIZE(layout) \
+   }
+
+// Layout tables
+static const watch_face_item_t classic_layout[] = {
+   { .field = WATCH_FIELD_STATIC, .text = "BLE Watch", .align = LV_ALIGN_TOP_MID },
+   { .field = WATCH_FIELD_DATE, .align = LV_ALIGN_TOP_LEFT, .x = 12, .y = 15 },
+   { .field = WATCH_FIELD_TIME, .align = LV_ALIGN_TOP_LEFT, .x = 32, .y = 30 },
+   // Message on the two bottom pages, the area shared with the marquee
+   { .field = WATCH_FIELD_MESSAGE, .align = LV_ALIGN_TOP_LEFT, .x = 0, .y = 48 },
+};
+
+static const watch_face_item_t large_clock_layout[] = {
+   { .field = WATCH_FIELD_TIME, .font = &lv_font_montserrat_28, .align = LV_ALIGN_CENTER, .y = -8 },
+   { .field = WATCH_FIELD_DATE, .align = LV_ALIGN_BOTTOM_MID },
+};
+
+static const watch_face_item_t messages_layout[] = {
+   { .field = WATCH_FIELD_STATIC, .text = "Messages", .align = LV_ALIGN_TOP_MID },
+   { .field = WATCH_FIELD_MSG_LIST, .align = LV_ALIGN_TOP_LEFT, .y = MSG_LIST_Y, .width = FACE_CACHE_WIDTH },
+};
+
+static const watch_face_item_t status_layout[] = {
+   { .field = WATCH_FIELD_STATIC, .text = "Status", .align = LV_ALIGN_TOP_MID },
+   { .field = WATCH_FIELD_STATUS, .align = LV_ALIGN_TOP_LEFT, .y = MSG_LIST_Y, .width = FACE_CACHE_WIDTH },
+};
+
+static const watch_face_item_t diagnostics_layout[] = {
+   { .field = WATCH_FIELD_STATIC, .text = "Diagnostics", .align = LV_ALIGN_TOP_MID },
+   { .field = WATCH_FIELD_DIAG, .align = LV_ALIGN_TOP_LEFT, .y = MSG_LIST_Y, .width = FACE_CACHE_WIDTH },
+};
+
+static const watch_face_t faces[WATCH_FACE_COUNT] = {
+   [WATCH_FACE_CLASSIC] = WATCH_FACE_LAYOUT("classic", classic_layout),
+   [WATCH_FACE_LARGE_CLOCK] = WATCH_FACE_LAYOUT("large clock", large_clock_layout),
+   [WATCH_FACE_MESSAGES] = WATCH_FACE_LAYOUT("messages", messages_layout),
+   [WATCH_FACE_STATUS] = WATCH_FACE_LAYOUT("status", status_layout),
+   [WATCH_FACE_DIAGNOSTICS] = WATCH_FACE_LAYOUT("diagnostics", diagnostics_layout),
+};
+
+BUILD_ASSERT(ARRAY_SIZE(classic_layout) <= FACE_CACHE_MAX_ITEMS);
+BUILD_ASSERT(ARRAY_SIZE(large_clock_layout) <= FACE_CACHE_MAX_ITEMS);
+BUILD_ASSERT(ARRAY_SIZE(messages_layout) <= FACE_CACHE_MAX_ITEMS);
+BUILD_ASSERT(ARRAY_SIZE(status_layout) <= FACE_CACHE_MAX_ITEMS);
+BUILD_ASSERT(ARRAY_SIZE(diagnostics_layout) <= FACE_CACHE_MAX_ITEMS);
+
+static const struct device *panel_dev;
+static lv_obj_t *screens[WATCH_FACE_COUNT];
+static lv_obj_t *labels[WATCH_FACE_COUNT][FACE_CACHE_MAX_ITEMS];
+// Incremented on every change of a field, compared with the caches
+static uint32_t field_versions[WATCH_FIELD_COUNT];
+static uint8_t active_face;
+
+// Selection requests from the button and GATT, taken by the event loop
+static atomic_t face_request = ATOMIC_INIT(FACE_REQUEST_NONE);
+static atomic_t face_next_requests;
+
+#if defined(CONFIG_APP_WATCH_FACE_CACHE)
+// Frames of the faces in the controller layout. Every flush of the active
+// face is mirrored into its cache, so a face shows its cache when selected
+// again and only the fields changed meanwhile are rendered.
+static struct face_cache caches[WATCH_FACE_COUNT];
+static lv_disp_drv_t *disp_drv;
+static void (*panel_flush_cb)(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p);
+static bool capture_only;
+
+static void watch_face_flush(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p);
+static void cache_render(void);
+static void cache_sync(uint8_t face);
+static bool cache_show(uint8_t face);
+#endif
+
+static void face_create(uint8_t face);
+
+int watch_face_init(const struct device *display_dev, uint8_t face)
+{
+   lv_obj_t *boot_screen = lv_scr_act();
+
+   if (face >= WATCH_FACE_COUNT)
+   {
+      return -EINVAL;
+   }
+
+   panel_dev = display_dev;
+
+   for (uint8_t i = 0U; i < WATCH_FACE_COUNT; i++)
+   {
+      face_create(i);
+   }
+
+#if defined(CONFIG_APP_WATCH_FACE_CACHE)
+   disp_drv = lv_disp_get_default()->driver;
+   panel_flush_cb = disp_drv->flush_cb;
+   disp_drv->flush_cb = watch_face_flush;
+#endif
+
+   // Drawn in full by the next refresh, which also fills its cache
+   active_face = face;
+   lv_disp_load_scr(screens[face]);
+   lv_obj_del(boot_screen);
+
+   return 0;
+}
+
+// Build the screen of a face from its layout table
+static void face_create(uint8_t face)
+{
+   const watch_face_t *layout = &faces[face];
+
+   screens[face] = lv_obj_create(NULL);
+
+   for (uint8_t i = 0U; i < layout->item_count; i++)
+   {
+      const watch_face_item_t *item = &layout->items[i];
+      lv_obj_t *label = lv_label_create(screens[face]);
+
+      if (item->font != NULL)
+      {
+         lv_obj_set_style_text_font(label, item->font, LV_PART_MAIN);
+      }
+
+      if (item->width > 0)
+      {
+         lv_obj_set_width(label, item->width);
+         lv_label_set_long_mode(label, LV_LABEL_LONG_CLIP);
+      }
+
+      lv_label_set_text(label, item->field == WATCH_FIELD_STATIC ? item->text : "");
+      lv_obj_align(label, item->align, item->x, item->y);
+
+      labels[face][i] = label;
+   }
+}
+
+// Set the text of a field on every face showing it. Faces not on screen
+// only get their labels updated, their caches become stale.
+void watch_face_set_text(uint8_t field, const char *text)
+{
+   bool changed = false;
+
+   if (field == WATCH_FIELD_STATIC || field >= WATCH_FIELD_COUNT)
+   {
+      return;
+   }
+
+   for (uint8_t face = 0U; face < WATCH_FACE_COUNT; face++)
+   {
+      for (uint8_t i = 0U; i < faces[face].item_count; i++)
+      {
+         if (faces[face].items[i].field == field &&
+             strcmp(lv_label_get_text(labels[face][i]), text) != 0)
+         {
+            lv_label_set_text(labels[face][i], text);
+            changed = true;
+         }
+      }
+   }
+
+   if (changed)
+   {
+      field_versions[field]++;
+   }
+}
+
+// Label of a field on a face, NULL if the face doesn't show it
+lv_obj_t *watch_face_get_label(uint8_t face, uint8_t field)
+{
+   if (face >= WATCH_FACE_COUNT)
+   {
+      return NULL;
+   }
+
+   for (uint8_t i = 0U; i < faces[face].item_count; i++)
+   {
+      if (faces[face].items[i].field == field)
+      {
+         return labels[face][i];
+      }
+   }
+
+   return NULL;
+}
+
+uint8_t watch_face_get_active(void)
+{
+   return active_face;
+}
+
+// Put a face on screen. With the cache this is a single full frame write
+// plus the fields changed since the face was last shown; without it the
+// face is rendered in full. Must run in the event loop, which owns LVGL.
+int watch_face_select(uint8_t face)
+{
+   bool cached = false;
+   uint32_t start;
+
+   if (face >= WATCH_FACE_COUNT)
+   {
+      return -EINVAL;
+   }
+
+   if (face == active_face)
+   {
+      return 0;
+   }
+
+   start = k_cycle_get_32();
+
+#if defined(CONFIG_APP_WATCH_FACE_CACHE)
+   lv_disp_t *disp = lv_disp_get_default();
+
+   // Complete the cache of the face being left, without writing the panel.
+   // Nothing is rendered when no area is pending.
+   cache_render();
+   cache_sync(active_face);
+
+   // The frame of a cached face covers the whole screen, so its load must
+   // not invalidate everything
+   lv_disp_enable_invalidation(disp, !caches[face].valid);
+#endif
+
+   lv_disp_load_scr(screens[face]);
+   active_face = face;
+
+#if defined(CONFIG_APP_WATCH_FACE_CACHE)
+   lv_disp_enable_invalidation(disp, true);
+#endif
+
+#if defined(CONFIG_APP_WATCH_FACE_CACHE)
+   cached = cache_show(face);
+#endif
+
+   // Render the stale fields, or the whole face
+   lv_refr_now(NULL);
+
+   LOG_DBG("Face %s on screen in %u us (%s)", faces[face].name,
+           k_cyc_to_us_floor32(k_cycle_get_32() - start), cached ? "cached" : "rendered");
+
+   return 0;
+}
+
+// Select a face from any context, e.g. the Bluetooth RX thread
+void watch_face_request(uint8_t face)
+{
+   atomic_set(&face_request, face);
+   app_event_post(APP_EVENT_FACE);
+}
+
+// Step to the next face from any context, e.g. a button ISR
+void watch_face_request_next(void)
+{
+   atomic_inc(&face_next_requests);
+   app_event_post(APP_EVENT_FACE);
+}
+
+// Face to select for the pending requests, if any
+bool watch_face_take_request(uint8_t *face)
+{
+   atomic_val_t request = atomic_set(&face_request, FACE_REQUEST_NONE);
+   atomic_val_t steps = atomic_set(&face_next_requests, 0);
+
+   if (request == FACE_REQUEST_NONE && steps == 0)
+   {
+      return false;
+   }
+
+   if (request == FACE_REQUEST_NONE || request >= WATCH_FACE_COUNT)
+   {
+      request = active_face;
+   }
+
+   *face = (uint8_t)((request + steps) % WATCH_FACE_COUNT);
+
+   return true;
+}
+
+#if defined(CONFIG_APP_WATCH_FACE_CACHE)
+// Mirror the flushes of the active face into its cache
+static void watch_face_flush(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p)
+{
+   face_cache_blit(&caches[active_face], (const uint8_t *)color_p, area->x1, area->y1,
+                   lv_area_get_width(area), lv_area_get_height(area));
+
+   if (capture_only)
+   {
+      lv_disp_flush_ready(drv);
+      return;
+   }
+
+   panel_flush_cb(drv, area, color_p);
+}
+
+// Render the pending areas of the active face into its cache only
+static void cache_render(void)
+{
+   capture_only = true;
+   lv_refr_now(NULL);
+   capture_only = false;
+}
+
+// The cache of the face is complete: record the field versions it shows
+// and where each label was drawn
+static void cache_sync(uint8_t face)
+{
+   const watch_face_t *layout = &faces[face];
+
+   for (uint8_t i = 0U; i < layout->item_count; i++)
+   {
+      lv_area_t coords;
+
+      lv_obj_get_coords(labels[face][i], &coords);
+
+      face_cache_area_t area = {
+         .x1 = coords.x1,
+         .y1 = coords.y1,
+         .x2 = coords.x2,
+         .y2 = coords.y2,
+      };
+
+      face_cache_mark(&caches[face], i, field_versions[layout->items[i].field], &area);
+   }
+
+   caches[face].valid = true;
+}
+
+// Write the cache of the face just loaded to the panel and invalidate only
+// the fields that changed since. The load of a face with a cache did not
+// invalidate the screen. Returns false if there is no cache yet.
+static bool cache_show(uint8_t face)
+{
+   const watch_face_t *layout = &faces[face];
+   struct display_buffer_descriptor desc = {
+      .buf_size = FACE_CACHE_SIZE,
+      .width = FACE_CACHE_WIDTH,
+      .height = FACE_CACHE_HEIGHT,
+      .pitch = FACE_CACHE_WIDTH,
+   };
+
+   if (!caches[face].valid)
+   {
+      return false;
+   }
+
+   if (display_write(panel_dev, 0, 0, &desc, caches[face].frame) < 0)
+   {
+      LOG_ERR("Face cache write failed");
+      // The load left the screen valid, render the whole face instead
+      lv_obj_invalidate(screens[face]);
+      return false;
+   }
+
+   lv_obj_update_layout(screens[face]);
+
+   for (uint8_t i = 0U; i < layout->item_count; i++)
+   {
+      if (face_cache_is_stale(&caches[face], i, field_versions[layout->items[i].field]))
+      {
+         const face_cache_area_t *cached = &caches[face].areas[i];
+         lv_area_t old_area = {
+            .x1 = cached->x1,
+            .y1 = cached->y1,
+            .x2 = cached->x2,
+            .y2 = cached->y2,
+         };
+
+         // Where the old text was drawn and where the new one goes
+         lv_obj_invalidate_area(screens[face], &old_area);
+         lv_obj_invalidate(labels[face][i]);
+      }
+   }
+
+   return true;
+}
+#endif
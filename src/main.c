@@ -11,26 +11,35 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "app_event.h"
+#include "dfu_smp.h"
 #include "display_ssd1306.h"
 #include "gatt_central.h"
+#include "latest_mailbox.h"
+#include "mpsc_queue.h"
 #include "rtc_ds3231.h"
+#include "templog.h"
+#include "watch_face.h"
 
 // Register module log name
 LOG_MODULE_REGISTER(Main, LOG_LEVEL_DBG);
 
-#define RTC_THREAD_STACK_SIZE 2048
-#define DISPLAY_THREAD_STACK_SIZE 2048
-#define RTC_THREAD_PRIORITY 7
-#define DISPLAY_THREAD_PRIORITY 6
+// Period of the LED toggle and battery simulation
+#define HEARTBEAT_PERIOD K_SECONDS(1)
+// Event loop wakeups are logged once per this many RTC ticks
+#define WAKEUP_LOG_TICKS 60
+// RTC ticks a failed firmware upload stays on screen
+#define DFU_FAILED_STATUS_TICKS 10
+// Text of the status and diagnostics faces
+#define FACE_TEXT_SIZE 96
 
 typedef struct rtc_msg
 {
    uint8_t msg_buffer[RTC_MSG_BUFFER_SIZE];
 } rtc_msg_t;
 
-struct k_msgq rtc_msg_queue;
-
-K_MSGQ_DEFINE(rtc_msg_queue, sizeof(rtc_msg_t), 2, 1);
+// Latest RTC time, the display only needs the newest one
+LATEST_MAILBOX_DEFINE(rtc_time_mailbox, rtc_msg_t);
 
 // The devicetree node identifier for the "led0" alias.
 #define LED0_NODE DT_ALIAS(led0)
@@ -41,57 +50,208 @@ K_MSGQ_DEFINE(rtc_msg_queue, sizeof(rtc_msg_t), 2, 1);
 
 static const struct gpio_dt_spec led0 = GPIO_DT_SPEC_GET(LED0_NODE, gpios);
 
-void rtc_thread(void)
+// The devicetree node identifier for the "sw0" alias, used to browse the message history.
+#define SW0_NODE DT_ALIAS(sw0)
+
+#if !DT_NODE_HAS_STATUS(SW0_NODE, okay)
+#error "Unsupported board: sw0 devicetree not defined"
+#endif
+
+static const struct gpio_dt_spec button0 = GPIO_DT_SPEC_GET(SW0_NODE, gpios);
+static struct gpio_callback button0_cb_data;
+
+// The devicetree node identifier for the "sw1" alias, used to switch the watch face.
+#define SW1_NODE DT_ALIAS(sw1)
+
+#if !DT_NODE_HAS_STATUS(SW1_NODE, okay)
+#error "Unsupported board: sw1 devicetree not defined"
+#endif
+
+static const struct gpio_dt_spec button1 = GPIO_DT_SPEC_GET(SW1_NODE, gpios);
+static struct gpio_callback button1_cb_data;
+
+// Button presses not yet handled by the event loop
+static atomic_t history_browse_requests;
+
+static void button0_pressed(const struct device *dev, struct gpio_callback *cb, uint32_t pins)
 {
-   rtc_msg_t msg_buffer;
+   atomic_inc(&history_browse_requests);
+   app_event_post(APP_EVENT_BUTTON);
+}
 
-   rtc_ds3231_init();
+static void button1_pressed(const struct device *dev, struct gpio_callback *cb, uint32_t pins)
+{
+   watch_face_request_next();
+}
 
-   while (1)
+static int button_init(const struct gpio_dt_spec *button, struct gpio_callback *cb_data,
+                       gpio_callback_handler_t handler)
+{
+   int err;
+
+   if (!device_is_ready(button->port))
    {
-      const char *rtc_msg_time = rtc_ds3231_get_last_time();
-      strncpy(msg_buffer.msg_buffer, rtc_msg_time, RTC_MSG_BUFFER_SIZE);
+      LOG_ERR("Device %s is not ready.", button->port->name);
+      return -ENODEV;
+   }
 
-      while (k_msgq_put(&rtc_msg_queue, &msg_buffer, K_NO_WAIT) != 0)
-      {
-         /* message queue is full: purge old data & try again */
-         k_msgq_purge(&rtc_msg_queue);
-      }
+   err = gpio_pin_configure_dt(button, GPIO_INPUT);
+   if (err < 0)
+   {
+      return err;
+   }
+
+   err = gpio_pin_interrupt_configure_dt(button, GPIO_INT_EDGE_TO_ACTIVE);
+   if (err < 0)
+   {
+      return err;
+   }
+
+   gpio_init_callback(cb_data, handler, BIT(button->pin));
+
+   return gpio_add_callback(button->port, cb_data);
+}
+
+// Text of the status and diagnostics faces, refreshed with the time
+static void face_fields_update(void)
+{
+   char text[FACE_TEXT_SIZE];
+   uint32_t sent;
+   uint32_t suppressed;
+   uint32_t log_start;
+   uint32_t log_end;
+
+   snprintf(text, sizeof(text), "BLE: %u connected\nBattery: %u%%\nFace: %u of %u",
+            gatt_server_connection_count(), gatt_server_battery_level(),
+            watch_face_get_active() + 1U, WATCH_FACE_COUNT);
+   display_ssd1306_set_field(WATCH_FIELD_STATUS, text);
+
+   gatt_server_get_notify_stats(&sent, &suppressed);
+   templog_get_range(&log_start, &log_end);
+
+   snprintf(text, sizeof(text), "Uptime: %u s\nWakeups: %u\nNotify: %u/%u\nTemp log: %u B",
+            k_uptime_get_32() / 1000U, app_event_wakeups(), sent, suppressed, log_end - log_start);
+   display_ssd1306_set_field(WATCH_FIELD_DIAG, text);
+}
+
+// Runs in the RTC driver context once per second
+static void rtc_tick(const char *date_time)
+{
+   rtc_msg_t msg_buffer;
+
+   strncpy(msg_buffer.msg_buffer, date_time, RTC_MSG_BUFFER_SIZE);
+   msg_buffer.msg_buffer[RTC_MSG_BUFFER_SIZE - 1] = '\0';
+
+   latest_mailbox_write(&rtc_time_mailbox, &msg_buffer);
+   app_event_post(APP_EVENT_RTC_TICK);
+
+   gatt_server_time_notify();
+}
+
+// LED toggle and battery level simulation, from the timer ISR
+static void heartbeat(struct k_timer *timer)
+{
+   gpio_pin_toggle_dt(&led0);
+
+   // Battery level simulation
+   gatt_server_battery_level_notify();
+}
+
+K_TIMER_DEFINE(heartbeat_timer, heartbeat, NULL);
+
+// Lowest unused stack of the event loop so far, to size CONFIG_MAIN_STACK_SIZE
+static void log_unused_stack(void)
+{
+#if defined(CONFIG_INIT_STACKS) && defined(CONFIG_THREAD_STACK_INFO)
+   size_t unused = 0;
 
-      k_sleep(K_SECONDS(1));
+   if (k_thread_stack_space_get(k_current_get(), &unused) == 0)
+   {
+      LOG_DBG("Event loop stack: %u of %u B unused", (uint32_t)unused, CONFIG_MAIN_STACK_SIZE);
    }
+#endif
 }
 
-void display_thread(void)
+// Single consumer of the application events, owns the display
+static void event_loop(void)
 {
    rtc_msg_t rtc_msg_buffer;
+   uint32_t rtc_msg_version = 0;
+   dfu_progress_t dfu_progress;
+   uint32_t dfu_progress_version = 0;
+   char dfu_status[DISPLAY_MSG_BUFFER_SIZE];
+   uint32_t dfu_status_ticks = 0;
    display_msg_t display_msg_buffer;
-
-   display_ssd1306_init();
+   uint32_t ticks = 0;
 
    while (1)
    {
+      uint32_t events = app_event_wait(K_FOREVER);
+
       // Handle RTC messages
-      if (k_msgq_get(&rtc_msg_queue, &rtc_msg_buffer, K_NO_WAIT) == 0)
+      if ((events & APP_EVENT_RTC_TICK) &&
+          latest_mailbox_read(&rtc_time_mailbox, &rtc_msg_buffer, &rtc_msg_version))
       {
          display_ssd1306_update_date_time(rtc_msg_buffer.msg_buffer);
+         face_fields_update();
+
+         if (dfu_status_ticks > 0U && --dfu_status_ticks == 0U)
+         {
+            display_ssd1306_set_status(NULL);
+         }
+
+         if (++ticks % WAKEUP_LOG_TICKS == 0U)
+         {
+            LOG_DBG("Event loop wakeups: %u", app_event_wakeups());
+            log_unused_stack();
+         }
       }
 
-      // Handle messages from BLE work queue
-      if (k_msgq_get(&display_msg_queue, &display_msg_buffer, K_NO_WAIT) == 0)
+      // Handle messages from BLE
+      if (events & APP_EVENT_DISPLAY_MSG)
       {
-         display_ssd1306_set_msg_string(display_msg_buffer.msg_buffer, (uint16_t)strlen(display_msg_buffer.msg_buffer));
+         while (mpsc_queue_get(&display_msg_queue, &display_msg_buffer) == 0)
+         {
+            display_ssd1306_set_msg_string(display_msg_buffer.msg_buffer, (uint16_t)strlen(display_msg_buffer.msg_buffer));
+            gatt_server_display_msg_notify();
+         }
       }
 
-      display_ssd1306_run_handler();
+      // Handle message history browsing from the button
+      if (events & APP_EVENT_BUTTON)
+      {
+         for (atomic_val_t presses = atomic_set(&history_browse_requests, 0); presses > 0; presses--)
+         {
+            display_ssd1306_history_browse();
+         }
+      }
+
+      // Handle watch face selection from the button or GATT
+      if (events & APP_EVENT_FACE)
+      {
+         uint8_t face;
+
+         if (watch_face_take_request(&face))
+         {
+            display_ssd1306_select_face(face);
+         }
+      }
+
+      // Handle firmware upload progress, the status stays on screen until
+      // the reset that swaps the image. A failed upload shows where it
+      // stopped for a few seconds, then the messages come back.
+      if ((events & APP_EVENT_DFU) &&
+          dfu_smp_get_progress(&dfu_progress, &dfu_progress_version))
+      {
+         dfu_progress_format(&dfu_progress, dfu_status, sizeof(dfu_status));
+         display_ssd1306_set_status(dfu_status);
+         dfu_status_ticks = dfu_progress.state == DFU_PROGRESS_FAILED ? DFU_FAILED_STATUS_TICKS : 0U;
+      }
 
-      k_sleep(K_MSEC(250));
+      display_ssd1306_run_handler();
    }
 }
 
-K_THREAD_DEFINE(rtc_thread_id, RTC_THREAD_STACK_SIZE, rtc_thread, NULL, NULL, NULL, RTC_THREAD_PRIORITY, 0, 100);
-K_THREAD_DEFINE(display_thread_id, DISPLAY_THREAD_STACK_SIZE, display_thread, NULL, NULL, NULL, DISPLAY_THREAD_PRIORITY, 0, 200);
-
 int main(void)
 {
    int err;
@@ -115,18 +275,40 @@ int main(void)
       return EXIT_FAILURE;
    }
 
+   err = button_init(&button0, &button0_cb_data, button0_pressed);
+   if (err < 0)
+   {
+      LOG_ERR("It was not possible configure the device %s.", button0.port->name);
+   }
+
+   err = button_init(&button1, &button1_cb_data, button1_pressed);
+   if (err < 0)
+   {
+      LOG_ERR("It was not possible configure the device %s.", button1.port->name);
+   }
+
+   display_ssd1306_init();
+
    // Start advertising
    gatt_central_bt_start_advertising();
 
-   while (1)
-   {
-      gpio_pin_toggle_dt(&led0);
+   k_timer_start(&heartbeat_timer, HEARTBEAT_PERIOD, HEARTBEAT_PERIOD);
 
-      // Battery level simulation
-      gatt_server_battery_level_notify();
+   rtc_ds3231_init(rtc_tick);
+
+   err = dfu_smp_init();
+   if (err < 0)
+   {
+      LOG_ERR("It was not possible to start the firmware update (err %d).", err);
+   }
 
-      k_sleep(K_SECONDS(1));
+   err = templog_init();
+   if (err < 0)
+   {
+      LOG_ERR("It was not possible to start the temperature log (err %d).", err);
    }
 
+   event_loop();
+
    return EXIT_SUCCESS;
 }
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2023 Charles Dias.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/ztest.h>
+#include <string.h>
+
+#include "dfu_progress.h"
+
+#define REPORT_INTERVAL_MS CONFIG_APP_DFU_REPORT_INTERVAL_MS
+
+static dfu_progress_t progress;
+
+static void dfu_progress_before(void *fixture)
+{
+	ARG_UNUSED(fixture);
+	memset(&progress, 0, sizeof(progress));
+}
+
+ZTEST_SUITE(tests_dfu_progress, NULL, NULL, dfu_progress_before, NULL, NULL);
+
+/**
+ * @brief Test percent and rate
+ *
+ * The rate is the average since the first chunk and reports are limited to
+ * one per interval, except for the last chunk.
+ */
+ZTEST(tests_dfu_progress, test_update)
+{
+	char status[32];
+
+	dfu_progress_start(&progress, 100000, 1000);
+
+	zassert_true(dfu_progress_update(&progress, 25000, 2000, REPORT_INTERVAL_MS),
+		     "Progress not reported");
+	zassert_equal(progress.percent, 25, "Wrong percent");
+	zassert_equal(progress.bytes_per_s, 25000, "Wrong rate");
+
+	dfu_progress_format(&progress, status, sizeof(status));
+	zassert_mem_equal(status, "DFU 25% 25.0kB/s", sizeof("DFU 25% 25.0kB/s"), "Wrong status");
+
+	zassert_false(dfu_progress_update(&progress, 26000, 2000 + REPORT_INTERVAL_MS - 1,
+					  REPORT_INTERVAL_MS), "Report not throttled");
+	zassert_true(dfu_progress_update(&progress, 100000, 2000 + REPORT_INTERVAL_MS - 1,
+					 REPORT_INTERVAL_MS), "Last chunk not reported");
+	zassert_equal(progress.percent, 100, "Wrong percent");
+}
+
+/**
+ * @brief Test the end of an upload
+ *
+ * A complete upload shows its duration, a failed one where it stopped, and
+ * no chunk is tracked after the end.
+ */
+ZTEST(tests_dfu_progress, test_finish)
+{
+	char status[32];
+
+	dfu_progress_start(&progress, 100000, 0);
+	dfu_progress_update(&progress, 40000, 1000, REPORT_INTERVAL_MS);
+	dfu_progress_finish(&progress, false, 1500);
+
+	zassert_equal(progress.state, DFU_PROGRESS_FAILED, "Wrong state");
+	dfu_progress_format(&progress, status, sizeof(status));
+	zassert_mem_equal(status, "DFU failed 40%", sizeof("DFU failed 40%"), "Wrong status");
+	zassert_false(dfu_progress_update(&progress, 50000, 2000, REPORT_INTERVAL_MS),
+		      "Chunk tracked after the end");
+
+	dfu_progress_start(&progress, 100000, 0);
+	dfu_progress_update(&progress, 100000, 4250, REPORT_INTERVAL_MS);
+	dfu_progress_finish(&progress, true, 4250);
+
+	dfu_progress_format(&progress, status, sizeof(status));
+	zassert_mem_equal(status, "DFU done 4.2s", sizeof("DFU done 4.2s"), "Wrong status");
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2023 Charles Dias.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/ztest.h>
+#include <string.h>
+
+#include "face_cache.h"
+
+#define FACES              5
+
+static struct face_cache caches[FACES];
+
+static const face_cache_area_t time_area = { .x1 = 32, .y1 = 30, .x2 = 95, .y2 = 45 };
+
+static void face_cache_before(void *fixture)
+{
+	ARG_UNUSED(fixture);
+	memset(caches, 0, sizeof(caches));
+}
+
+ZTEST_SUITE(tests_face_cache, NULL, NULL, face_cache_before, NULL, NULL);
+
+/**
+ * @brief Test the frame layout
+ *
+ * A flushed area lands in its pages and columns and nothing else changes.
+ */
+ZTEST(tests_face_cache, test_blit)
+{
+	uint8_t buf[2 * 16];
+
+	for (size_t i = 0; i < sizeof(buf); i++) {
+		buf[i] = (uint8_t)(i + 1U);
+	}
+
+	// 16 columns by 2 pages at column 8, page 3
+	face_cache_blit(&caches[0], buf, 8, 24, 16, 16);
+
+	for (int page = 0; page < FACE_CACHE_HEIGHT / 8; page++) {
+		for (int col = 0; col < FACE_CACHE_WIDTH; col++) {
+			uint8_t byte = caches[0].frame[page * FACE_CACHE_WIDTH + col];
+			bool inside = page >= 3 && page < 5 && col >= 8 && col < 24;
+
+			if (inside) {
+				zassert_equal(byte, buf[(page - 3) * 16 + col - 8],
+					      "Wrong byte at page %d column %d", page, col);
+			} else {
+				zassert_equal(byte, 0, "Byte outside the area written");
+			}
+		}
+	}
+
+	// Areas outside the screen are ignored
+	face_cache_blit(&caches[1], buf, 120, 0, 16, 8);
+	face_cache_blit(&caches[1], buf, 0, 64, 16, 8);
+
+	for (size_t i = 0; i < FACE_CACHE_SIZE; i++) {
+		zassert_equal(caches[1].frame[i], 0, "Area outside the screen written");
+	}
+}
+
+/**
+ * @brief Test the stale fields
+ *
+ * A cache without a frame is stale, then an item is stale once its field
+ * changes after the frame was captured.
+ */
+ZTEST(tests_face_cache, test_stale)
+{
+	zassert_true(face_cache_is_stale(&caches[0], 0, 0), "Empty cache not stale");
+
+	face_cache_mark(&caches[0], 0, 3, &time_area);
+	caches[0].valid = true;
+
+	zassert_false(face_cache_is_stale(&caches[0], 0, 3), "Cached item stale");
+	zassert_true(face_cache_is_stale(&caches[0], 0, 4), "Changed item not stale");
+	zassert_equal(caches[0].areas[0].x2, time_area.x2, "Item area not kept");
+	zassert_true(face_cache_is_stale(&caches[0], FACE_CACHE_MAX_ITEMS, 0),
+		     "Unknown item not stale");
+}
@@ -0,0 +1,350 @@
+/*
+ * Copyright (c) 2023 Charles Dias.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/ztest.h>
+#include <zephyr/kernel.h>
+#include <string.h>
+
+#include "latest_mailbox.h"
+#include "mpsc_queue.h"
+
+#define QUEUE_CAPACITY     8
+#define PRODUCERS          3
+#define ITEMS_PER_PRODUCER 2000
+#define MAILBOX_WRITES     20000
+#define STACK_SIZE         1024
+#define ISR_ITEMS          2000
+#define ISR_PERIOD_US      100
+
+struct sample
+{
+	uint32_t a;
+	uint32_t b;
+	uint32_t c;
+	uint32_t d;
+};
+
+struct item
+{
+	uint32_t producer;
+	uint32_t index;
+};
+
+MPSC_QUEUE_DEFINE(test_queue, sizeof(struct item), QUEUE_CAPACITY);
+K_MSGQ_DEFINE(test_msgq, sizeof(struct item), QUEUE_CAPACITY, 4);
+LATEST_MAILBOX_DEFINE(test_mailbox, struct sample);
+
+K_THREAD_STACK_ARRAY_DEFINE(worker_stacks, PRODUCERS, STACK_SIZE);
+static struct k_thread workers[PRODUCERS];
+static atomic_t producer_retries;
+static atomic_t msgq_purged;
+static struct k_timer isr_producer_timer;
+static uint32_t isr_next_index;
+static atomic_t isr_full;
+
+// Same priority as the test thread, so k_yield() alternates between them
+static int worker_priority(void)
+{
+	return k_thread_priority_get(k_current_get());
+}
+
+static void drain_queue(void)
+{
+	struct item item;
+
+	while (mpsc_queue_get(&test_queue, &item) == 0) {
+	}
+}
+
+static void queue_before(void *fixture)
+{
+	ARG_UNUSED(fixture);
+	drain_queue();
+	k_msgq_purge(&test_msgq);
+	atomic_clear(&test_mailbox.seq);
+	memset(test_mailbox.data, 0, test_mailbox.size);
+	atomic_clear(&producer_retries);
+	atomic_clear(&msgq_purged);
+	atomic_clear(&isr_full);
+	isr_next_index = 0;
+}
+
+ZTEST_SUITE(tests_mailbox_queue, NULL, NULL, queue_before, NULL, NULL);
+
+/**
+ * @brief Test queue order and overflow
+ *
+ * Items come out in order and a full queue rejects new items instead of
+ * dropping queued ones.
+ */
+ZTEST(tests_mailbox_queue, test_queue_full)
+{
+	struct item item;
+
+	for (uint32_t i = 0; i < QUEUE_CAPACITY; i++) {
+		item.index = i;
+		zassert_ok(mpsc_queue_put(&test_queue, &item), "Put failed before full");
+	}
+
+	item.index = QUEUE_CAPACITY;
+	zassert_equal(mpsc_queue_put(&test_queue, &item), -ENOMEM, "Full queue accepted item");
+
+	for (uint32_t i = 0; i < QUEUE_CAPACITY; i++) {
+		zassert_ok(mpsc_queue_get(&test_queue, &item), "Queued item missing");
+		zassert_equal(item.index, i, "Wrong order");
+	}
+
+	zassert_equal(mpsc_queue_get(&test_queue, &item), -EAGAIN, "Empty queue returned item");
+}
+
+/**
+ * @brief Test mailbox versions
+ *
+ * The reader gets the newest value once and nothing until the next write.
+ */
+ZTEST(tests_mailbox_queue, test_mailbox_latest)
+{
+	struct sample value = { 1, 1, 1, 1 };
+	struct sample read;
+	uint32_t version = 0;
+
+	latest_mailbox_write(&test_mailbox, &value);
+	value.a = 2;
+	latest_mailbox_write(&test_mailbox, &value);
+
+	zassert_true(latest_mailbox_read(&test_mailbox, &read, &version), "No value");
+	zassert_equal(read.a, 2, "Not the newest value");
+	zassert_false(latest_mailbox_read(&test_mailbox, &read, &version), "Same version read twice");
+}
+
+static void mpsc_producer(void *p1, void *p2, void *p3)
+{
+	struct item item = { .producer = POINTER_TO_UINT(p1) };
+
+	for (item.index = 0; item.index < ITEMS_PER_PRODUCER; item.index++) {
+		while (mpsc_queue_put(&test_queue, &item) != 0) {
+			atomic_inc(&producer_retries);
+			k_yield();
+		}
+
+		// Let the other producers and the consumer run between puts
+		k_yield();
+	}
+}
+
+static void msgq_producer(void *p1, void *p2, void *p3)
+{
+	struct item item = { .producer = POINTER_TO_UINT(p1) };
+
+	// Pattern replaced in the application: purge on full
+	for (item.index = 0; item.index < ITEMS_PER_PRODUCER; item.index++) {
+		while (k_msgq_put(&test_msgq, &item, K_NO_WAIT) != 0) {
+			atomic_add(&msgq_purged, k_msgq_num_used_get(&test_msgq));
+			k_msgq_purge(&test_msgq);
+		}
+	}
+}
+
+static void start_workers(k_thread_entry_t entry)
+{
+	for (uint32_t i = 0; i < PRODUCERS; i++) {
+		k_thread_create(&workers[i], worker_stacks[i], STACK_SIZE, entry,
+				UINT_TO_POINTER(i), NULL, NULL, worker_priority(), 0, K_NO_WAIT);
+	}
+}
+
+static void join_workers(void)
+{
+	for (uint32_t i = 0; i < PRODUCERS; i++) {
+		k_thread_join(&workers[i], K_FOREVER);
+	}
+}
+
+/**
+ * @brief Test the MPSC queue order with interleaved producers
+ *
+ * Several producers take turns with the test thread after every put. Every
+ * item must arrive, in order per producer. The threads only switch in
+ * k_yield(), so the puts never race: this covers ordering and the full
+ * queue path. Concurrent puts are covered by test_mpsc_isr_producer.
+ */
+ZTEST(tests_mailbox_queue, test_mpsc_interleaved_order)
+{
+	uint32_t next[PRODUCERS] = { 0 };
+	uint32_t received = 0;
+	struct item item;
+
+	start_workers(mpsc_producer);
+
+	while (received < PRODUCERS * ITEMS_PER_PRODUCER) {
+		if (mpsc_queue_get(&test_queue, &item) != 0) {
+			k_yield();
+			continue;
+		}
+
+		zassert_equal(item.index, next[item.producer], "Item lost or out of order");
+		next[item.producer]++;
+		received++;
+	}
+
+	join_workers();
+
+	TC_PRINT("mpsc_queue: %u items, %ld producer retries\n",
+		 received, atomic_get(&producer_retries));
+}
+
+// Producer in interrupt context: it preempts the thread producers in the
+// middle of a put on the board. A full queue is retried on the next period.
+static void isr_producer_expiry(struct k_timer *timer)
+{
+	struct item item = { .producer = PRODUCERS, .index = isr_next_index };
+
+	if (mpsc_queue_put(&test_queue, &item) != 0) {
+		atomic_inc(&isr_full);
+		return;
+	}
+
+	if (++isr_next_index == ISR_ITEMS) {
+		k_timer_stop(timer);
+	}
+}
+
+/**
+ * @brief Test the MPSC queue with a producer in a timer ISR
+ *
+ * A timer ISR puts items while the producer threads put theirs. On the
+ * board the ISR interrupts a put between its position claim and the slot
+ * hand over, so both producers really race for the head. Every item must
+ * still arrive once, in order per producer. native_sim only delivers
+ * interrupts while the CPU waits, so there the run does not race.
+ */
+ZTEST(tests_mailbox_queue, test_mpsc_isr_producer)
+{
+	uint32_t next[PRODUCERS + 1] = { 0 };
+	uint32_t received = 0;
+	struct item item;
+
+	k_timer_init(&isr_producer_timer, isr_producer_expiry, NULL);
+	k_timer_start(&isr_producer_timer, K_USEC(ISR_PERIOD_US), K_USEC(ISR_PERIOD_US));
+	start_workers(mpsc_producer);
+
+	while (received < PRODUCERS * ITEMS_PER_PRODUCER + ISR_ITEMS) {
+		if (mpsc_queue_get(&test_queue, &item) != 0) {
+			// Let time pass so the timer fires on native_sim too
+			k_busy_wait(1);
+			k_yield();
+			continue;
+		}
+
+		zassert_true(item.producer <= PRODUCERS, "Corrupted item");
+		zassert_equal(item.index, next[item.producer], "Item lost or out of order");
+		next[item.producer]++;
+		received++;
+	}
+
+	join_workers();
+	k_timer_stop(&isr_producer_timer);
+
+	zassert_equal(mpsc_queue_get(&test_queue, &item), -EAGAIN, "Item put twice");
+
+	TC_PRINT("mpsc_queue with ISR producer: %u items, %ld thread retries, %ld ISR retries\n",
+		 received, atomic_get(&producer_retries), atomic_get(&isr_full));
+}
+
+/**
+ * @brief Test the purge on full k_msgq pattern
+ *
+ * Same load as the MPSC ordering test, for comparison. Reports the items
+ * lost to purges, which the MPSC queue never loses.
+ */
+ZTEST(tests_mailbox_queue, test_msgq_purge_loss)
+{
+	uint32_t received = 0;
+	struct item item;
+
+	start_workers(msgq_producer);
+
+	while (received + atomic_get(&msgq_purged) < PRODUCERS * ITEMS_PER_PRODUCER) {
+		if (k_msgq_get(&test_msgq, &item, K_NO_WAIT) != 0) {
+			k_yield();
+			continue;
+		}
+
+		received++;
+	}
+
+	join_workers();
+
+	TC_PRINT("k_msgq purge: %u items, %ld lost\n", received, atomic_get(&msgq_purged));
+}
+
+// Same sequence protocol as latest_mailbox_write, but switching to the
+// reader halfway through the value, as a preempted writer would
+static void mailbox_write_interrupted(struct latest_mailbox *mb, const struct sample *value)
+{
+	struct sample *data = mb->data;
+
+	atomic_inc(&mb->seq);
+
+	data->a = value->a;
+	data->b = value->b;
+	k_yield();
+	data->c = value->c;
+	data->d = value->d;
+
+	atomic_inc(&mb->seq);
+}
+
+static void mailbox_writer(void *p1, void *p2, void *p3)
+{
+	for (uint32_t i = 1; i <= MAILBOX_WRITES; i++) {
+		struct sample value = { i, i, i, i };
+
+		if ((i % 2U) == 0U) {
+			mailbox_write_interrupted(&test_mailbox, &value);
+		} else {
+			latest_mailbox_write(&test_mailbox, &value);
+		}
+
+		k_yield();
+	}
+}
+
+/**
+ * @brief Test the mailbox torn read path with an interleaved writer
+ *
+ * Every other write yields to the reader between the two halves of the
+ * value. The reader must retry instead of returning a torn value, and the
+ * versions must only move forward.
+ */
+ZTEST(tests_mailbox_queue, test_mailbox_interleaved_torn_read)
+{
+	struct sample read = { 0 };
+	uint32_t version = 0;
+	uint32_t reads = 0;
+	uint32_t last = 0;
+
+	k_thread_create(&workers[0], worker_stacks[0], STACK_SIZE, mailbox_writer,
+			NULL, NULL, NULL, worker_priority(), 0, K_NO_WAIT);
+
+	while (last < MAILBOX_WRITES) {
+		if (!latest_mailbox_read(&test_mailbox, &read, &version)) {
+			k_yield();
+			continue;
+		}
+
+		zassert_true(read.a == read.b && read.b == read.c && read.c == read.d, "Torn read");
+		zassert_true(read.a > last, "Old value read");
+		last = read.a;
+		reads++;
+	}
+
+	k_thread_join(&workers[0], K_FOREVER);
+
+	zassert_true(reads >= MAILBOX_WRITES / 2U, "Reader did not keep up with the writer");
+
+	TC_PRINT("latest_mailbox: %u writes, %u reads\n", MAILBOX_WRITES, reads);
+}
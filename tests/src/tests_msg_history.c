@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2023 Charles Dias.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/ztest.h>
+#include <zephyr/sys/byteorder.h>
+#include <string.h>
+
+#include "msg_history.h"
+
+#define HISTORY_SIZE CONFIG_APP_MSG_HISTORY_SIZE
+
+static void msg_history_before(void *fixture)
+{
+	ARG_UNUSED(fixture);
+	msg_history_clear();
+}
+
+ZTEST_SUITE(tests_msg_history, NULL, NULL, msg_history_before, NULL, NULL);
+
+/**
+ * @brief Test insertion and lookup
+ *
+ * Sequence numbers increase by one and every stored message can be read back.
+ */
+ZTEST(tests_msg_history, test_add_get)
+{
+	msg_history_entry_t entry;
+	uint32_t first = msg_history_add("hello", 5, 100);
+	uint32_t second = msg_history_add("world", 5, 101);
+
+	zassert_equal(second, first + 1, "Sequence numbers are not contiguous");
+
+	zassert_ok(msg_history_get(first, &entry), "First message not found");
+	zassert_equal(entry.timestamp, 100, "Wrong timestamp");
+	zassert_equal(entry.len, 5, "Wrong length");
+	zassert_mem_equal(entry.msg_buffer, "hello", 6, "Wrong message");
+
+	zassert_equal(msg_history_get(second + 1, &entry), -ENOENT, "Unknown sequence found");
+}
+
+/**
+ * @brief Test eviction
+ *
+ * When the ring is full the oldest message is evicted and the range moves.
+ */
+ZTEST(tests_msg_history, test_eviction)
+{
+	msg_history_entry_t entry;
+	uint32_t oldest_seq;
+	uint32_t newest_seq;
+	uint32_t first = msg_history_add("0", 1, 0);
+
+	for (int i = 1; i <= HISTORY_SIZE; i++) {
+		msg_history_add("x", 1, i);
+	}
+
+	zassert_equal(msg_history_range(&oldest_seq, &newest_seq), HISTORY_SIZE, "Wrong count");
+	zassert_equal(oldest_seq, first + 1, "Oldest message not evicted");
+	zassert_equal(newest_seq, first + HISTORY_SIZE, "Wrong newest sequence");
+	zassert_equal(msg_history_get(first, &entry), -ENOENT, "Evicted message found");
+	zassert_ok(msg_history_get(newest_seq, &entry), "Newest message not found");
+	zassert_equal(entry.timestamp, HISTORY_SIZE, "Wrong newest timestamp");
+}
+
+/**
+ * @brief Test page encoding
+ *
+ * A page holds only the messages that fit and starts at the requested sequence.
+ */
+ZTEST(tests_msg_history, test_encode_page)
+{
+	uint8_t page[MSG_HISTORY_PAGE_HEADER_SIZE + 2 * (MSG_HISTORY_ENTRY_HEADER_SIZE + 4)];
+	uint32_t first = msg_history_add("aaaa", 4, 10);
+
+	msg_history_add("bbbb", 4, 11);
+	msg_history_add("cccc", 4, 12);
+
+	size_t size = msg_history_encode_page(0, page, sizeof(page));
+
+	zassert_equal(size, sizeof(page), "Wrong page size");
+	zassert_equal(sys_get_le32(&page[0]), first, "Wrong oldest sequence");
+	zassert_equal(sys_get_le32(&page[4]), first + 2, "Wrong newest sequence");
+	zassert_equal(page[8], 2, "Wrong number of messages");
+	zassert_mem_equal(&page[MSG_HISTORY_PAGE_HEADER_SIZE + MSG_HISTORY_ENTRY_HEADER_SIZE],
+			  "aaaa", 4, "Wrong first message");
+
+	size = msg_history_encode_page(first + 2, page, sizeof(page));
+
+	zassert_equal(page[8], 1, "Wrong number of messages");
+	zassert_equal(sys_get_le32(&page[MSG_HISTORY_PAGE_HEADER_SIZE]), first + 2,
+		      "Page does not start at the requested sequence");
+	zassert_equal(size, MSG_HISTORY_PAGE_HEADER_SIZE + MSG_HISTORY_ENTRY_HEADER_SIZE + 4,
+		      "Wrong page size");
+}
+
+/**
+ * @brief Test pages at the default ATT MTU
+ *
+ * A read response of MTU 23 holds 22 bytes, room for the headers and 4
+ * characters. Longer messages are never truncated: a page of the minimum
+ * size holds the longest message in full, read with Read Blob requests.
+ */
+ZTEST(tests_msg_history, test_encode_page_min_mtu)
+{
+	static const char longest[DISPLAY_MSG_BUFFER_SIZE] = "0123456789abcdefghijklmnopqrstu";
+	uint8_t page[MSG_HISTORY_PAGE_MIN_SIZE];
+	uint32_t first = msg_history_add(longest, sizeof(longest) - 1, 10);
+	uint32_t seq = first;
+
+	msg_history_add("ok", 2, 11);
+
+	size_t size = msg_history_encode_page(seq, page, 23 - 1);
+
+	zassert_equal(page[8], 0, "Message returned truncated");
+	zassert_equal(size, MSG_HISTORY_PAGE_HEADER_SIZE, "Wrong page size");
+
+	size = msg_history_encode_page(seq, page, sizeof(page));
+
+	zassert_equal(size, sizeof(page), "Wrong page size");
+	zassert_equal(page[8], 1, "Long message not returned");
+	zassert_equal(page[MSG_HISTORY_PAGE_HEADER_SIZE + 8], sizeof(longest) - 1, "Wrong length");
+	zassert_mem_equal(&page[MSG_HISTORY_PAGE_HEADER_SIZE + MSG_HISTORY_ENTRY_HEADER_SIZE],
+			  longest, sizeof(longest) - 1, "Wrong message");
+
+	seq += page[8];
+	size = msg_history_encode_page(seq, page, sizeof(page));
+
+	zassert_equal(page[8], 1, "Next message not returned");
+	zassert_equal(sys_get_le32(&page[MSG_HISTORY_PAGE_HEADER_SIZE]), first + 1,
+		      "Reader did not move forward");
+	zassert_equal(size, MSG_HISTORY_PAGE_HEADER_SIZE + MSG_HISTORY_ENTRY_HEADER_SIZE + 2,
+		      "Wrong page size");
+}
@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2023 Charles Dias.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/ztest.h>
+#include <string.h>
+
+#include "templog_codec.h"
+#include "templog_ring.h"
+
+#define BLOCK_SIZE        CONFIG_APP_TEMPLOG_BLOCK_SIZE
+#define PERIOD_S          CONFIG_APP_TEMPLOG_PERIOD_S
+#define WEEK_SAMPLES      (7U * 24U * 3600U / PERIOD_S)
+#define STREAM_SIZE       (WEEK_SAMPLES * 2U)
+// Notification payload is the ATT MTU minus the opcode, the handle and
+// the stream offset
+#define NOTIFY_PAYLOAD(mtu) ((mtu) - 3U - 4U)
+
+static uint8_t stream[STREAM_SIZE];
+static int16_t samples[WEEK_SAMPLES];
+static struct templog_ring ring;
+static uint16_t spilled_len[2 * TEMPLOG_RING_BLOCKS];
+static uint32_t spilled;
+
+struct decode_state {
+	uint32_t count;
+	uint32_t timestamp;
+	bool ok;
+};
+
+// Indoor temperature: slow daily swing in quarter degrees with sensor noise
+static int16_t sample_at(uint32_t n)
+{
+	static uint32_t noise = 1U;
+	uint32_t day_pos = (n * PERIOD_S) % (24U * 3600U);
+	int32_t swing = (int32_t)(day_pos < 12U * 3600U ? day_pos : 24U * 3600U - day_pos);
+
+	noise = noise * 1103515245U + 12345U;
+
+	return (int16_t)(80 + swing / 1800 + (int32_t)((noise >> 16) % 3U) - 1);
+}
+
+// Encode samples as the log does, a new block whenever the current is full
+static uint32_t encode(const int16_t *values, uint32_t count, uint32_t timestamp)
+{
+	templog_block_t block;
+	uint32_t offset = 0;
+
+	templog_block_start(&block, stream, BLOCK_SIZE, offset, timestamp, PERIOD_S, values[0]);
+
+	for (uint32_t i = 1; i < count; i++) {
+		if (templog_block_append(&block, values[i]) == -ENOSPC) {
+			offset += block.used;
+			templog_block_start(&block, &stream[offset], BLOCK_SIZE, offset,
+					    timestamp + i * PERIOD_S, PERIOD_S, values[i]);
+		}
+	}
+
+	return offset + block.used;
+}
+
+static void decode_check(uint32_t timestamp, int16_t temp_q, void *user_data)
+{
+	struct decode_state *state = user_data;
+
+	if (timestamp != state->timestamp + state->count * PERIOD_S ||
+	    temp_q != samples[state->count]) {
+		state->ok = false;
+	}
+
+	state->count++;
+}
+
+static void spill_record(const uint8_t *buf, uint16_t len)
+{
+	if (spilled < ARRAY_SIZE(spilled_len)) {
+		spilled_len[spilled] = len;
+	}
+
+	spilled++;
+}
+
+static void templog_before(void *fixture)
+{
+	ARG_UNUSED(fixture);
+	templog_ring_init(&ring, 0);
+	spilled = 0;
+}
+
+ZTEST_SUITE(tests_templog, NULL, NULL, templog_before, NULL, NULL);
+
+/**
+ * @brief Test encode and decode round trip
+ *
+ * Small steps are stored as deltas, large ones as absolute samples, and
+ * every sample decodes back with its timestamp.
+ */
+ZTEST(tests_templog, test_round_trip)
+{
+	static const int16_t values[] = { 100, 101, 99, 99, 400, 398, -200, -200, -74, 53 };
+	struct decode_state state = { .timestamp = 1000, .ok = true };
+	uint32_t size;
+
+	memcpy(samples, values, sizeof(values));
+	size = encode(values, ARRAY_SIZE(values), state.timestamp);
+
+	// Header, 7 deltas and 2 absolute samples
+	zassert_equal(size, TEMPLOG_BLOCK_HEADER_SIZE + 7 + 2 * 3, "Wrong encoded size");
+	zassert_equal(templog_decode(stream, size, decode_check, &state), ARRAY_SIZE(values),
+		      "Wrong sample count");
+	zassert_true(state.ok, "Decoded samples differ");
+}
+
+/**
+ * @brief Test block boundaries
+ *
+ * A full block reports -ENOSPC and the next block carries its own stream
+ * offset, so a transfer can resume at any block.
+ */
+ZTEST(tests_templog, test_block_full)
+{
+	templog_block_t block;
+	uint32_t appended = 0;
+
+	templog_block_start(&block, stream, BLOCK_SIZE, 0x1234, 0, PERIOD_S, 0);
+
+	while (templog_block_append(&block, 0) == 0) {
+		appended++;
+	}
+
+	zassert_equal(appended, BLOCK_SIZE - TEMPLOG_BLOCK_HEADER_SIZE, "Wrong block capacity");
+	zassert_equal(block.used, BLOCK_SIZE, "Block not filled");
+	zassert_equal(templog_block_offset(stream), 0x1234, "Wrong block offset");
+
+	// An absolute sample does not fit in the last byte
+	block.used = BLOCK_SIZE - 1U;
+	zassert_equal(templog_block_append(&block, 1000), -ENOSPC, "Absolute sample overflows");
+}
+
+/**
+ * @brief Test malformed streams
+ *
+ * A stream must start with a block and hold whole samples.
+ */
+ZTEST(tests_templog, test_decode_malformed)
+{
+	uint32_t size;
+
+	samples[0] = 10;
+	samples[1] = 1000;
+	size = encode(samples, 2, 0);
+
+	zassert_equal(templog_decode(&stream[1], size - 1U, NULL, NULL), -EINVAL,
+		      "Stream without block accepted");
+	zassert_equal(templog_decode(stream, size - 1U, NULL, NULL), -EINVAL,
+		      "Truncated sample accepted");
+	zassert_equal(templog_decode(stream, TEMPLOG_BLOCK_HEADER_SIZE - 1U, NULL, NULL),
+		      -EINVAL, "Truncated header accepted");
+}
+
+/**
+ * @brief Test a failed read in the middle of a block
+ *
+ * A gap closes the open block with its current length, even when its RAM
+ * slot held a full block on the previous lap of the ring. Reads and the
+ * spilled block must both use that length.
+ */
+ZTEST(tests_templog, test_ring_gap)
+{
+	const uint32_t block_samples = TEMPLOG_RING_BLOCK_SIZE - TEMPLOG_BLOCK_HEADER_SIZE + 1U;
+	uint32_t count = 0;
+	uint32_t gap_offset;
+	uint32_t offset;
+	uint32_t size = 0;
+	uint16_t read;
+
+	// One full lap of the ring, then the first slot is reused
+	for (uint32_t i = 0; i < TEMPLOG_RING_BLOCKS * block_samples; i++) {
+		templog_ring_append(&ring, 0, 0, spill_record);
+	}
+
+	zassert_equal(spilled, 0, "Block spilled before the ring was full");
+
+	gap_offset = ring.end;
+	zassert_true(templog_ring_append(&ring, 0, 0, spill_record), "Oldest block not dropped");
+	templog_ring_append(&ring, 1, 0, spill_record);
+	templog_ring_append(&ring, 2, 0, spill_record);
+
+	// Failed read, the next sample starts a new block after the short one
+	templog_ring_close(&ring);
+	templog_ring_append(&ring, 3, 0, spill_record);
+
+	zassert_equal(templog_block_offset(ring.current.buf), gap_offset + TEMPLOG_BLOCK_HEADER_SIZE + 2U,
+		      "New block does not follow the closed one");
+	zassert_equal(templog_ring_read(&ring, gap_offset, stream, TEMPLOG_RING_BLOCK_SIZE),
+		      TEMPLOG_BLOCK_HEADER_SIZE + 2U, "Closed block read with a stale length");
+
+	// The RAM content decodes as whole blocks up to the end
+	for (offset = templog_ring_start(&ring); offset < ring.end; offset += read) {
+		read = templog_ring_read(&ring, offset, &stream[size], TEMPLOG_RING_BLOCK_SIZE);
+		zassert_true(read > 0, "Offset %u missing", offset);
+		size += read;
+	}
+
+	count = templog_decode(stream, size, NULL, NULL);
+	zassert_equal(count, (TEMPLOG_RING_BLOCKS - 2U) * block_samples + 3U + 1U,
+		      "Wrong sample count in RAM");
+
+	// Spill blocks until the short one leaves the ring
+	while (spilled < TEMPLOG_RING_BLOCKS + 1U) {
+		templog_ring_append(&ring, 3, 0, spill_record);
+	}
+
+	zassert_equal(spilled_len[0], TEMPLOG_RING_BLOCK_SIZE, "Full block spilled short");
+	zassert_equal(spilled_len[TEMPLOG_RING_BLOCKS], TEMPLOG_BLOCK_HEADER_SIZE + 2U,
+		      "Closed block spilled with a stale length");
+}
+
+/**
+ * @brief Benchmark the codec on a week of samples
+ *
+ * Reports the encoded size against raw 16 bit samples, the number of
+ * notifications needed to download it at the default and the maximum MTU,
+ * and the encode and decode time. The download throughput depends on the
+ * link and is measured on the board: the transfer logs its bytes, duration
+ * and rate when it completes.
+ */
+ZTEST(tests_templog, test_bench_week_codec)
+{
+	struct decode_state state = { .timestamp = 0, .ok = true };
+	uint32_t start;
+	uint32_t encode_cycles;
+	uint32_t decode_cycles;
+	uint32_t size;
+
+	for (uint32_t i = 0; i < WEEK_SAMPLES; i++) {
+		samples[i] = sample_at(i);
+	}
+
+	start = k_cycle_get_32();
+	size = encode(samples, WEEK_SAMPLES, state.timestamp);
+	encode_cycles = k_cycle_get_32() - start;
+
+	start = k_cycle_get_32();
+	zassert_equal(templog_decode(stream, size, decode_check, &state), WEEK_SAMPLES,
+		      "Wrong sample count");
+	decode_cycles = k_cycle_get_32() - start;
+
+	zassert_true(state.ok, "Decoded samples differ");
+	zassert_true(size < STREAM_SIZE, "Encoding larger than raw samples");
+
+	// One more notification with the offset only marks the end
+	TC_PRINT("templog: %u samples, %u bytes (raw %u), %u notifications at MTU 23, "
+		 "%u at MTU 247\n",
+		 WEEK_SAMPLES, size, STREAM_SIZE,
+		 DIV_ROUND_UP(size, NOTIFY_PAYLOAD(23U)) + 1U,
+		 DIV_ROUND_UP(size, NOTIFY_PAYLOAD(247U)) + 1U);
+	TC_PRINT("templog: encode %llu ns/sample, decode %llu ns/sample\n",
+		 k_cyc_to_ns_floor64(encode_cycles) / WEEK_SAMPLES,
+		 k_cyc_to_ns_floor64(decode_cycles) / WEEK_SAMPLES);
+}